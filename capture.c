@@ -0,0 +1,174 @@
+#include "capture.h"
+#include "trace.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Write one frame to its PPM file or to the encoder pipe
+static bool writeFrame(FrameCapture *capture, const Uint8 *pixels, unsigned int frameNumber) {
+    TRACE_ZONE("writeFrame");
+    size_t bytes = (size_t)capture->pitch * capture->height;
+    if (capture->pipe) {
+        if (capture->pipeClosed) return false;
+        if (fwrite(pixels, 1, bytes, capture->pipe) == bytes) return true;
+        // Usually EPIPE: the encoder exited, so stop feeding it
+        printf("Encoder stopped accepting frames (%s)\n", strerror(errno));
+        capture->pipeClosed = true;
+        return false;
+    }
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/frame_%06u.ppm", capture->directory, frameNumber);
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", capture->width, capture->height);
+    bool ok = fwrite(pixels, 1, bytes, file) == bytes;
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// Writer thread: drain filled buffers in order and return them to the pool
+static int captureThread(void *data) {
+    FrameCapture *capture = (FrameCapture*)data;
+    TRACE_THREAD_NAME("capture");
+
+    SDL_LockMutex(capture->lock);
+    while (1) {
+        while (capture->readyCount == 0 && !capture->stopping) {
+            SDL_CondWait(capture->frameReady, capture->lock);
+        }
+        if (capture->readyCount == 0) break;  // Stopping and fully drained
+
+        int index = capture->readyBuffers[capture->readyHead];
+        unsigned int frameNumber = capture->readyFrames[capture->readyHead];
+        capture->readyHead = (capture->readyHead + 1) % capture->bufferCount;
+        capture->readyCount--;
+        SDL_UnlockMutex(capture->lock);
+
+        bool ok = writeFrame(capture, capture->buffers[index], frameNumber);
+
+        SDL_LockMutex(capture->lock);
+        if (!ok) capture->failed++;
+        capture->freeBuffers[capture->freeCount++] = index;
+    }
+    SDL_UnlockMutex(capture->lock);
+    return 0;
+}
+
+// Frame capture operations implementation
+bool startCapture(FrameCapture *capture, int width, int height, int bufferCount, const char *target) {
+    memset(capture, 0, sizeof(*capture));
+    capture->width = width;
+    capture->height = height;
+    capture->pitch = width * 3;
+    capture->bufferCount = bufferCount;
+
+    if (target[0] == '|') {
+        // An encoder that exits early must fail the write, not kill the process
+        signal(SIGPIPE, SIG_IGN);
+        capture->pipe = popen(target + 1, "w");
+        if (!capture->pipe) {
+            printf("Could not start encoder: %s\n", target + 1);
+            return false;
+        }
+    } else {
+        snprintf(capture->directory, sizeof(capture->directory), "%s", target);
+        if (mkdir(capture->directory, 0755) != 0 && errno != EEXIST) {
+            printf("Could not create capture directory %s\n", capture->directory);
+            return false;
+        }
+    }
+
+    capture->buffers = (Uint8**)calloc(bufferCount, sizeof(Uint8*));
+    capture->freeBuffers = (int*)malloc(bufferCount * sizeof(int));
+    capture->readyBuffers = (int*)malloc(bufferCount * sizeof(int));
+    capture->readyFrames = (unsigned int*)malloc(bufferCount * sizeof(unsigned int));
+    bool ok = capture->buffers && capture->freeBuffers && capture->readyBuffers && capture->readyFrames;
+    for (int i = 0; ok && i < bufferCount; i++) {
+        capture->buffers[i] = (Uint8*)malloc((size_t)capture->pitch * height);
+        capture->freeBuffers[capture->freeCount++] = i;
+        ok = capture->buffers[i] != NULL;
+    }
+
+    capture->lock = SDL_CreateMutex();
+    capture->frameReady = SDL_CreateCond();
+    ok = ok && capture->lock && capture->frameReady;
+    if (ok) {
+        capture->thread = SDL_CreateThread(captureThread, "capture", capture);
+        ok = capture->thread != NULL;
+    }
+    if (!ok) {
+        printf("Could not start frame capture\n");
+        stopCapture(capture);
+    }
+    return ok;
+}
+
+bool captureFrame(FrameCapture *capture, SDL_Renderer *renderer) {
+    unsigned int frameNumber = capture->frameNumber++;
+
+    // Take a free buffer; if the writer is behind, drop this frame rather than wait
+    SDL_LockMutex(capture->lock);
+    if (capture->freeCount == 0) {
+        capture->dropped++;
+        SDL_UnlockMutex(capture->lock);
+        return false;
+    }
+    int index = capture->freeBuffers[--capture->freeCount];
+    SDL_UnlockMutex(capture->lock);
+
+    bool ok = SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGB24,
+                                   capture->buffers[index], capture->pitch) == 0;
+
+    SDL_LockMutex(capture->lock);
+    if (ok) {
+        int tail = (capture->readyHead + capture->readyCount) % capture->bufferCount;
+        capture->readyBuffers[tail] = index;
+        capture->readyFrames[tail] = frameNumber;
+        capture->readyCount++;
+        capture->captured++;
+        SDL_CondSignal(capture->frameReady);
+    } else {
+        capture->failed++;
+        capture->freeBuffers[capture->freeCount++] = index;
+    }
+    SDL_UnlockMutex(capture->lock);
+    return ok;
+}
+
+void stopCapture(FrameCapture *capture) {
+    // Let the writer drain every queued frame before it exits
+    if (capture->thread) {
+        SDL_LockMutex(capture->lock);
+        capture->stopping = true;
+        SDL_CondSignal(capture->frameReady);
+        SDL_UnlockMutex(capture->lock);
+        SDL_WaitThread(capture->thread, NULL);
+        capture->thread = NULL;
+    }
+
+    if (capture->pipe) {
+        pclose(capture->pipe);
+        capture->pipe = NULL;
+    }
+    if (capture->frameReady) SDL_DestroyCond(capture->frameReady);
+    if (capture->lock) SDL_DestroyMutex(capture->lock);
+    capture->frameReady = NULL;
+    capture->lock = NULL;
+
+    if (capture->buffers) {
+        for (int i = 0; i < capture->bufferCount; i++) {
+            free(capture->buffers[i]);
+        }
+    }
+    free(capture->buffers);
+    free(capture->freeBuffers);
+    free(capture->readyBuffers);
+    free(capture->readyFrames);
+    capture->buffers = NULL;
+    capture->freeBuffers = NULL;
+    capture->readyBuffers = NULL;
+    capture->readyFrames = NULL;
+}
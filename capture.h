@@ -0,0 +1,42 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Records rendered frames without stalling the main loop. Frames are read
+// back into a fixed pool of recycled buffers and written out by a
+// background thread; when every buffer is busy the frame is dropped.
+typedef struct {
+    int width;
+    int height;
+    int pitch;                  // Bytes per row of an RGB24 frame
+    int bufferCount;
+    Uint8** buffers;            // Pool of frame buffers
+    int* freeBuffers;           // Stack of buffer indices ready for reuse
+    int freeCount;
+    int* readyBuffers;          // FIFO of filled buffer indices
+    unsigned int* readyFrames;  // Frame number of each filled buffer
+    int readyHead;
+    int readyCount;
+    SDL_mutex* lock;
+    SDL_cond* frameReady;
+    SDL_Thread* thread;
+    bool stopping;
+    char directory[256];        // PPM sequence output directory
+    FILE* pipe;                 // Encoder process receiving raw RGB24 frames
+    bool pipeClosed;            // Encoder stopped reading; later frames fail
+    unsigned int frameNumber;
+    unsigned int captured;      // Frames handed to the writer thread
+    unsigned int dropped;       // Frames skipped because no buffer was free
+    unsigned int failed;        // Frames the writer could not write
+} FrameCapture;
+
+// Frame capture operations. target is a directory for a PPM sequence, or
+// "|command" to pipe raw RGB24 frames to a local encoder.
+bool startCapture(FrameCapture *capture, int width, int height, int bufferCount, const char *target);
+bool captureFrame(FrameCapture *capture, SDL_Renderer *renderer);
+void stopCapture(FrameCapture *capture);
+
+#endif /* CAPTURE_H */
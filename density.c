@@ -0,0 +1,67 @@
+#include "density.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Vehicles per cell at which the heatmap reaches full intensity
+#define DENSITY_SATURATION 8
+
+// Density map operations implementation
+bool initDensityMap(DensityMap *map, SDL_Renderer *renderer, int width, int height, int cellSize) {
+    map->cellSize = cellSize;
+    map->cols = (width + cellSize - 1) / cellSize;
+    map->rows = (height + cellSize - 1) / cellSize;
+    map->counts = (Uint16*)calloc(map->cols * map->rows, sizeof(Uint16));
+    map->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                     map->cols, map->rows);
+    if (!map->counts || !map->texture) {
+        freeDensityMap(map);
+        return false;
+    }
+    SDL_SetTextureBlendMode(map->texture, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+void freeDensityMap(DensityMap *map) {
+    free(map->counts);
+    map->counts = NULL;
+    if (map->texture) {
+        SDL_DestroyTexture(map->texture);
+        map->texture = NULL;
+    }
+}
+
+void clearDensityMap(DensityMap *map) {
+    memset(map->counts, 0, map->cols * map->rows * sizeof(Uint16));
+}
+
+void addDensity(DensityMap *map, int x, int y) {
+    if (x < 0 || y < 0) return;
+    int col = x / map->cellSize;
+    int row = y / map->cellSize;
+    if (col >= map->cols || row >= map->rows) return;
+
+    Uint16 *count = &map->counts[row * map->cols + col];
+    if (*count < UINT16_MAX) (*count)++;
+}
+
+void renderDensityMap(DensityMap *map, SDL_Renderer *renderer) {
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(map->texture, NULL, &pixels, &pitch) != 0) return;
+
+    // Empty cells stay transparent; occupied cells ramp from yellow to red
+    for (int row = 0; row < map->rows; row++) {
+        Uint32 *texel = (Uint32*)((Uint8*)pixels + row * pitch);
+        const Uint16 *count = &map->counts[row * map->cols];
+        for (int col = 0; col < map->cols; col++) {
+            int level = count[col] < DENSITY_SATURATION ? count[col] : DENSITY_SATURATION;
+            Uint32 green = 255 - level * 255 / DENSITY_SATURATION;
+            Uint32 alpha = level ? 128 + level * 127 / DENSITY_SATURATION : 0;
+            texel[col] = (alpha << 24) | (255u << 16) | (green << 8);
+        }
+    }
+    SDL_UnlockTexture(map->texture);
+
+    SDL_Rect dest = {0, 0, map->cols * map->cellSize, map->rows * map->cellSize};
+    SDL_RenderCopy(renderer, map->texture, NULL, &dest);
+}
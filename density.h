@@ -0,0 +1,24 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Coarse occupancy grid drawn as a heatmap when there are too many
+// vehicles to draw one by one
+typedef struct {
+    int cellSize;           // Screen pixels covered by one cell
+    int cols;
+    int rows;
+    Uint16* counts;         // Vehicles per cell for the current frame
+    SDL_Texture* texture;   // Streaming texture with one texel per cell
+} DensityMap;
+
+// Density map operations
+bool initDensityMap(DensityMap *map, SDL_Renderer *renderer, int width, int height, int cellSize);
+void freeDensityMap(DensityMap *map);
+void clearDensityMap(DensityMap *map);
+void addDensity(DensityMap *map, int x, int y);  // Count one vehicle centred at (x, y)
+void renderDensityMap(DensityMap *map, SDL_Renderer *renderer);
+
+#endif /* DENSITY_H */
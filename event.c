@@ -0,0 +1,89 @@
+#include "event.h"
+#include <stdlib.h>
+
+// Returns true if event a must fire before event b
+static bool eventBefore(const Event *a, const Event *b) {
+    if (a->time != b->time) {
+        // Compare through the signed difference so the ordering survives
+        // wrap-around of the millisecond clock
+        return (int)(a->time - b->time) < 0;
+    }
+    return a->seq < b->seq;
+}
+
+static void swapEvents(Event *a, Event *b) {
+    Event tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+// Event queue operations implementation
+void initEventQueue(EventQueue *q, int capacity) {
+    q->events = (Event*)malloc(capacity * sizeof(Event));
+    q->capacity = q->events ? capacity : 0;
+    q->size = 0;
+    q->nextSeq = 0;
+}
+
+void freeEventQueue(EventQueue *q) {
+    free(q->events);
+    q->events = NULL;
+    q->capacity = 0;
+    q->size = 0;
+}
+
+bool isEventQueueEmpty(EventQueue *q) {
+    return q->size == 0;
+}
+
+bool scheduleEvent(EventQueue *q, unsigned int time, EventType type, int target, int slot) {
+    return restoreEvent(q, (Event){time, q->nextSeq++, type, target, slot});
+}
+
+bool restoreEvent(EventQueue *q, Event event) {
+    if (q->size == q->capacity) {
+        int newCapacity = q->capacity > 0 ? q->capacity * 2 : 16;
+        Event *grown = (Event*)realloc(q->events, newCapacity * sizeof(Event));
+        if (!grown) return false;
+        q->events = grown;
+        q->capacity = newCapacity;
+    }
+
+    // Append at the bottom of the heap and sift up
+    int i = q->size++;
+    q->events[i] = event;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!eventBefore(&q->events[i], &q->events[parent])) break;
+        swapEvents(&q->events[i], &q->events[parent]);
+        i = parent;
+    }
+    return true;
+}
+
+bool popDueEvent(EventQueue *q, unsigned int now, Event *event) {
+    if (isEventQueueEmpty(q) || (int)(q->events[0].time - now) > 0) {
+        return false;  // Nothing due yet
+    }
+
+    *event = q->events[0];
+    q->events[0] = q->events[--q->size];
+
+    // Sift the moved element down to restore the heap
+    int i = 0;
+    while (1) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+        if (left < q->size && eventBefore(&q->events[left], &q->events[smallest])) smallest = left;
+        if (right < q->size && eventBefore(&q->events[right], &q->events[smallest])) smallest = right;
+        if (smallest == i) break;
+        swapEvents(&q->events[i], &q->events[smallest]);
+        i = smallest;
+    }
+    return true;
+}
+
+unsigned int nextEventTime(EventQueue *q) {
+    return isEventQueueEmpty(q) ? 0 : q->events[0].time;
+}
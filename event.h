@@ -0,0 +1,38 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdbool.h>
+
+// Kinds of discrete events driving the simulation
+typedef enum {
+    EVENT_LANE_ENTRY,   // A generated vehicle enters its lane
+    EVENT_PHASE_CHANGE, // A traffic light switches state
+    EVENT_LANE_EXIT     // A vehicle has left the screen at its destination
+} EventType;
+
+typedef struct {
+    unsigned int time;  // Simulation time the event fires at (milliseconds)
+    unsigned int seq;   // Insertion order, keeps events with equal times FIFO
+    EventType type;
+    int target;         // Queue or traffic light index the event applies to
+    int slot;           // Vehicle slot within the queue (lane exit only)
+} Event;
+
+// Min-heap of pending events ordered by (time, seq)
+typedef struct {
+    Event* events;
+    int capacity;
+    int size;
+    unsigned int nextSeq;
+} EventQueue;
+
+// Event queue operations
+void initEventQueue(EventQueue *q, int capacity);
+void freeEventQueue(EventQueue *q);
+bool isEventQueueEmpty(EventQueue *q);
+bool scheduleEvent(EventQueue *q, unsigned int time, EventType type, int target, int slot);
+bool restoreEvent(EventQueue *q, Event event);  // Re-insert a saved event, keeping its seq
+bool popDueEvent(EventQueue *q, unsigned int now, Event *event);
+unsigned int nextEventTime(EventQueue *q);
+
+#endif /* EVENT_H */
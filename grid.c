@@ -0,0 +1,71 @@
+#include "grid.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Cell range covered by a rectangle, clipped to the grid. Returns false if
+// the rectangle lies entirely outside.
+static bool coveredCells(const SpatialGrid *grid, int x, int y, int width, int height,
+                         int *minCol, int *minRow, int *maxCol, int *maxRow) {
+    int left = x - grid->originX;
+    int top = y - grid->originY;
+    int right = left + width - 1;
+    int bottom = top + height - 1;
+    if (right < 0 || bottom < 0 ||
+        left >= grid->cols * grid->cellSize || top >= grid->rows * grid->cellSize) {
+        return false;
+    }
+    *minCol = left > 0 ? left / grid->cellSize : 0;
+    *minRow = top > 0 ? top / grid->cellSize : 0;
+    *maxCol = right / grid->cellSize < grid->cols ? right / grid->cellSize : grid->cols - 1;
+    *maxRow = bottom / grid->cellSize < grid->rows ? bottom / grid->cellSize : grid->rows - 1;
+    return true;
+}
+
+// Spatial grid operations implementation
+bool initSpatialGrid(SpatialGrid *grid, int x, int y, int width, int height, int cellSize) {
+    grid->originX = x;
+    grid->originY = y;
+    grid->cellSize = cellSize;
+    grid->cols = (width + cellSize - 1) / cellSize;
+    grid->rows = (height + cellSize - 1) / cellSize;
+    grid->lanes = (uint8_t*)calloc(grid->cols * grid->rows, sizeof(uint8_t));
+    return grid->lanes != NULL;
+}
+
+void freeSpatialGrid(SpatialGrid *grid) {
+    free(grid->lanes);
+    grid->lanes = NULL;
+    grid->cols = 0;
+    grid->rows = 0;
+}
+
+void clearSpatialGrid(SpatialGrid *grid) {
+    memset(grid->lanes, 0, grid->cols * grid->rows * sizeof(uint8_t));
+}
+
+bool gridOverlaps(const SpatialGrid *grid, int x, int y, int width, int height) {
+    int minCol, minRow, maxCol, maxRow;
+    return coveredCells(grid, x, y, width, height, &minCol, &minRow, &maxCol, &maxRow);
+}
+
+void addToGrid(SpatialGrid *grid, int x, int y, int width, int height, int lane) {
+    int minCol, minRow, maxCol, maxRow;
+    if (!coveredCells(grid, x, y, width, height, &minCol, &minRow, &maxCol, &maxRow)) return;
+    for (int row = minRow; row <= maxRow; row++) {
+        for (int col = minCol; col <= maxCol; col++) {
+            grid->lanes[row * grid->cols + col] |= 1u << lane;
+        }
+    }
+}
+
+bool gridConflict(const SpatialGrid *grid, int x, int y, int width, int height, unsigned int lanes) {
+    int minCol, minRow, maxCol, maxRow;
+    if (!coveredCells(grid, x, y, width, height, &minCol, &minRow, &maxCol, &maxRow)) return false;
+    uint8_t others = (uint8_t)~lanes;
+    for (int row = minRow; row <= maxRow; row++) {
+        for (int col = minCol; col <= maxCol; col++) {
+            if (grid->lanes[row * grid->cols + col] & others) return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,29 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Uniform grid over a rectangular area (the intersection box). Vehicles are
+// registered by footprint every step; each cell records which lanes cover
+// it, so a conflict query touches only the cells a footprint covers instead
+// of comparing vehicles pairwise. Up to 8 lanes.
+typedef struct {
+    int originX;            // Top-left corner of the area in pixels
+    int originY;
+    int cellSize;
+    int cols;
+    int rows;
+    uint8_t* lanes;         // Bit per lane with a vehicle in the cell
+} SpatialGrid;
+
+// Spatial grid operations. Rectangles are in pixels and may extend past the
+// area; only the covered cells inside it are used.
+bool initSpatialGrid(SpatialGrid *grid, int x, int y, int width, int height, int cellSize);
+void freeSpatialGrid(SpatialGrid *grid);
+void clearSpatialGrid(SpatialGrid *grid);
+bool gridOverlaps(const SpatialGrid *grid, int x, int y, int width, int height);
+void addToGrid(SpatialGrid *grid, int x, int y, int width, int height, int lane);
+bool gridConflict(const SpatialGrid *grid, int x, int y, int width, int height, unsigned int lanes);
+
+#endif /* GRID_H */
@@ -0,0 +1,244 @@
+#include "ingest.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How often files are checked when inotify is unavailable, and how long
+// the reader backs off while every batch is in use (milliseconds)
+#define INGEST_POLL_MS 50
+#define INGEST_BACKOFF_MS 1
+
+// Ring operations. Each ring has exactly one producer and one consumer
+// thread; release/acquire on the indices publishes the slot contents.
+static bool pushBatch(BatchRing *ring, IngestBatch *batch) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head == INGEST_RING_SIZE) return false;
+    ring->slots[tail & (INGEST_RING_SIZE - 1)] = batch;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static IngestBatch* popBatch(BatchRing *ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) return NULL;
+    IngestBatch* batch = ring->slots[head & (INGEST_RING_SIZE - 1)];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return batch;
+}
+
+// Hand the current batch to the simulation
+static void publishBatch(Ingest *ingest) {
+    if (!ingest->current || ingest->current->count == 0) return;
+    while (!pushBatch(&ingest->filled, ingest->current)) {
+        SDL_Delay(INGEST_BACKOFF_MS);  // Cannot happen with one ring slot per batch
+    }
+    ingest->current = NULL;
+}
+
+// Batch with room for one more vehicle; waits while every batch is in use.
+// Returns NULL if the reader is asked to stop while waiting.
+static IngestBatch* writableBatch(Ingest *ingest) {
+    if (ingest->current && ingest->current->count == INGEST_BATCH_SIZE) {
+        publishBatch(ingest);
+    }
+    while (!ingest->current) {
+        ingest->current = popBatch(&ingest->recycled);
+        if (ingest->current) {
+            ingest->current->count = 0;
+            ingest->current->next = 0;
+        } else if (atomic_load(&ingest->stopping)) {
+            return NULL;
+        } else {
+            SDL_Delay(INGEST_BACKOFF_MS);
+        }
+    }
+    return ingest->current;
+}
+
+// Parse a "NUMBER:A2:0" record as written by the traffic generator
+static bool parseRecord(const char *line, QueuedVehicle *vehicle) {
+    char number[9];
+    char road;
+    int lane, priority;
+    if (sscanf(line, "%8[A-Z0-9]:%c%d:%d", number, &road, &lane, &priority) != 4 ||
+        road < 'A' || road > 'D' || lane < 1 || lane > 3) {
+        return false;
+    }
+    memset(vehicle, 0, sizeof(*vehicle));
+    memcpy(vehicle->number, number, sizeof(vehicle->number));
+    vehicle->road = road;
+    vehicle->lane = lane;
+    vehicle->priority = priority;
+    return true;
+}
+
+static bool addLine(Ingest *ingest, const char *line) {
+    QueuedVehicle vehicle;
+    if (!parseRecord(line, &vehicle)) {
+        atomic_fetch_add_explicit(&ingest->malformed, 1, memory_order_relaxed);
+        return true;
+    }
+    IngestBatch* batch = writableBatch(ingest);
+    if (!batch) return false;
+    batch->vehicles[batch->count++] = vehicle;
+    atomic_fetch_add_explicit(&ingest->ingested, 1, memory_order_relaxed);
+    return true;
+}
+
+// Read whatever was appended to one lane file since the last call
+static void readLaneFile(Ingest *ingest, int index) {
+    TRACE_ZONE("readLaneFile");
+    char path[300];
+    snprintf(path, sizeof(path), "%s/lane%c.txt", ingest->directory, 'A' + index);
+
+    struct stat info;
+    if (stat(path, &info) != 0) return;
+    if (info.st_size < ingest->offsets[index]) {
+        // The generator restarted and truncated the file
+        ingest->offsets[index] = 0;
+        ingest->partialLength[index] = 0;
+    }
+    if (info.st_size == ingest->offsets[index]) return;
+
+    FILE* file = fopen(path, "r");
+    if (!file) return;
+    fseek(file, ingest->offsets[index], SEEK_SET);
+
+    char chunk[65536];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        ingest->offsets[index] += length;
+        char* line = ingest->partial[index];
+        int* lineLength = &ingest->partialLength[index];
+        for (size_t i = 0; i < length; i++) {
+            if (chunk[i] != '\n') {
+                // Over-long lines are truncated and then fail to parse
+                if (*lineLength < (int)sizeof(ingest->partial[index]) - 1) {
+                    line[(*lineLength)++] = chunk[i];
+                }
+                continue;
+            }
+            line[*lineLength] = '\0';
+            *lineLength = 0;
+            if (line[0] != '\0' && !addLine(ingest, line)) {
+                fclose(file);
+                return;
+            }
+        }
+    }
+    fclose(file);
+}
+
+static void readAllLaneFiles(Ingest *ingest) {
+    for (int i = 0; i < INGEST_FILES; i++) {
+        readLaneFile(ingest, i);
+    }
+    publishBatch(ingest);  // Deliver partial batches promptly at low rates
+}
+
+// I/O thread: read the files whenever they change until asked to stop
+static int ingestThread(void *data) {
+    Ingest *ingest = (Ingest*)data;
+    TRACE_THREAD_NAME("ingest");
+
+#ifdef __linux__
+    int watcher = inotify_init1(IN_NONBLOCK);
+    if (watcher >= 0 && inotify_add_watch(watcher, ingest->directory,
+                                          IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0) {
+        close(watcher);
+        watcher = -1;
+    }
+#endif
+
+    readAllLaneFiles(ingest);
+    while (!atomic_load(&ingest->stopping)) {
+#ifdef __linux__
+        if (watcher >= 0) {
+            // Wake on any change in the directory; the timeout only serves
+            // to notice stop requests
+            struct pollfd request = {watcher, POLLIN, 0};
+            if (poll(&request, 1, 100) <= 0) continue;
+            char events[4096];
+            while (read(watcher, events, sizeof(events)) > 0) {}
+        } else {
+            SDL_Delay(INGEST_POLL_MS);
+        }
+#else
+        SDL_Delay(INGEST_POLL_MS);
+#endif
+        readAllLaneFiles(ingest);
+    }
+
+#ifdef __linux__
+    if (watcher >= 0) close(watcher);
+#endif
+    return 0;
+}
+
+// Ingest operations implementation
+bool startIngest(Ingest *ingest, const char *directory) {
+    memset(ingest, 0, sizeof(*ingest));
+    snprintf(ingest->directory, sizeof(ingest->directory), "%s", directory);
+    atomic_init(&ingest->filled.head, 0);
+    atomic_init(&ingest->filled.tail, 0);
+    atomic_init(&ingest->recycled.head, 0);
+    atomic_init(&ingest->recycled.tail, 0);
+    atomic_init(&ingest->stopping, false);
+    atomic_init(&ingest->ingested, 0);
+    atomic_init(&ingest->malformed, 0);
+
+    ingest->batches = (IngestBatch*)malloc(INGEST_RING_SIZE * sizeof(IngestBatch));
+    if (!ingest->batches) {
+        printf("Could not allocate ingest batches\n");
+        return false;
+    }
+    for (int i = 0; i < INGEST_RING_SIZE; i++) {
+        pushBatch(&ingest->recycled, &ingest->batches[i]);
+    }
+
+    ingest->thread = SDL_CreateThread(ingestThread, "ingest", ingest);
+    if (!ingest->thread) {
+        printf("Could not start ingest thread! SDL_Error: %s\n", SDL_GetError());
+        free(ingest->batches);
+        ingest->batches = NULL;
+        return false;
+    }
+    return true;
+}
+
+IngestBatch* nextIngestBatch(Ingest *ingest) {
+    if (ingest->held) {
+        IngestBatch* batch = ingest->held;
+        ingest->held = NULL;
+        return batch;
+    }
+    return popBatch(&ingest->filled);
+}
+
+void holdIngestBatch(Ingest *ingest, IngestBatch *batch) {
+    ingest->held = batch;
+}
+
+void releaseIngestBatch(Ingest *ingest, IngestBatch *batch) {
+    pushBatch(&ingest->recycled, batch);
+}
+
+void stopIngest(Ingest *ingest) {
+    if (ingest->thread) {
+        atomic_store(&ingest->stopping, true);
+        SDL_WaitThread(ingest->thread, NULL);
+        ingest->thread = NULL;
+    }
+    free(ingest->batches);
+    ingest->batches = NULL;
+}
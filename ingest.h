@@ -0,0 +1,57 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "queue.h"
+
+#define INGEST_BATCH_SIZE 256   // Vehicles per batch
+#define INGEST_RING_SIZE 64     // Batches in flight; power of two
+#define INGEST_FILES 4          // laneA.txt to laneD.txt
+
+// Parsed vehicles handed from the I/O thread to the simulation
+typedef struct {
+    int count;
+    int next;               // First vehicle the simulation has not taken yet
+    QueuedVehicle vehicles[INGEST_BATCH_SIZE];
+} IngestBatch;
+
+// Lock-free single-producer single-consumer ring of batch pointers
+typedef struct {
+    IngestBatch* slots[INGEST_RING_SIZE];
+    atomic_uint head;       // Next slot the consumer takes
+    atomic_uint tail;       // Next slot the producer fills
+} BatchRing;
+
+// Follows the generator's lane files on a background thread. New lines are
+// parsed there and passed over in batches, so the main loop never touches
+// the disk. Batches travel to the simulation through filled and come back
+// through recycled; when none are free the reader waits, bounding memory.
+typedef struct {
+    char directory[256];
+    long offsets[INGEST_FILES];     // Bytes of each file already read
+    char partial[INGEST_FILES][64]; // Unfinished last line of each file
+    int partialLength[INGEST_FILES];
+    IngestBatch* batches;
+    IngestBatch* current;           // Batch being filled by the I/O thread
+    BatchRing filled;               // I/O thread -> simulation
+    BatchRing recycled;             // Simulation -> I/O thread
+    IngestBatch* held;              // Partly taken batch handed back by the simulation
+    SDL_Thread* thread;
+    atomic_bool stopping;
+    atomic_uint ingested;           // Vehicles parsed
+    atomic_uint malformed;          // Lines that could not be parsed
+} Ingest;
+
+// Ingest operations. nextIngestBatch, holdIngestBatch and releaseIngestBatch
+// are called from the simulation thread only. A held batch comes back from
+// the next nextIngestBatch call ahead of newer ones, so while the simulation
+// cannot take it the rings back up and the reader waits.
+bool startIngest(Ingest *ingest, const char *directory);
+IngestBatch* nextIngestBatch(Ingest *ingest);  // NULL when nothing is ready
+void holdIngestBatch(Ingest *ingest, IngestBatch *batch);
+void releaseIngestBatch(Ingest *ingest, IngestBatch *batch);
+void stopIngest(Ingest *ingest);
+
+#endif /* INGEST_H */
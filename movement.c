@@ -0,0 +1,201 @@
+#include "movement.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Returns true while a fixed-point coordinate has not yet reached the leg target
+static inline bool beforeTarget(int value, const RouteLeg *leg) {
+    int target = toFixed(leg->target);
+    return leg->direction > 0 ? value < target : value > target;
+}
+
+void routeDirection(const LaneRoute *route, int x, int y, int *dx, int *dy) {
+    *dx = 0;
+    *dy = 0;
+    for (int i = 0; i < 2; i++) {
+        const RouteLeg *leg = &route->legs[i];
+        if (leg->direction == 0) break;
+        if (beforeTarget(leg->axis == AXIS_X ? x : y, leg)) {
+            *(leg->axis == AXIS_X ? dx : dy) = leg->direction;
+            return;
+        }
+    }
+}
+
+bool routeExited(const LaneRoute *route, int x, int y) {
+    return !beforeTarget(route->exit.axis == AXIS_X ? x : y, &route->exit);
+}
+
+bool inStopRegion(const LaneRoute *route, int x, int y) {
+    return x >= toFixed(route->stopMinX) && x <= toFixed(route->stopMaxX) &&
+           y >= toFixed(route->stopMinY) && y <= toFixed(route->stopMaxY);
+}
+
+// Scalar kernel, also used for the tail of the vectorised loops
+int moveLaneScalar(const LaneRoute *route, bool lightRed, int16_t *x, int16_t *y,
+                   const uint8_t *speed, const int16_t *active, LaneGates gates,
+                   int16_t *exited, int count) {
+    const RouteLeg *first = &route->legs[0];
+    const RouteLeg *second = &route->legs[1];
+    const int minX = toFixed(route->stopMinX), maxX = toFixed(route->stopMaxX);
+    const int minY = toFixed(route->stopMinY), maxY = toFixed(route->stopMaxY);
+    int moved = 0;
+
+    for (int i = 0; i < count; i++) {
+        exited[i] = 0;
+        if (!active[i]) continue;
+
+        bool held = gates.hold[i] ||
+                    (lightRed && !gates.clearing[i] &&
+                     x[i] >= minX && x[i] <= maxX &&
+                     y[i] >= minY && y[i] <= maxY);
+        if (!held) {
+            int16_t *c1 = first->axis == AXIS_X ? &x[i] : &y[i];
+            int16_t *c2 = second->axis == AXIS_X ? &x[i] : &y[i];
+            if (beforeTarget(*c1, first)) {
+                *c1 += first->direction * speed[i];
+                moved++;
+            } else if (second->direction != 0 && beforeTarget(*c2, second)) {
+                *c2 += second->direction * speed[i];
+                moved++;
+            }
+        }
+
+        int exitCoord = route->exit.axis == AXIS_X ? x[i] : y[i];
+        exited[i] = beforeTarget(exitCoord, &route->exit) ? 0 : -1;
+    }
+    return moved;
+}
+
+#if defined(__AVX2__)
+#define LANE_WIDTH_SIMD 16
+typedef __m256i vint;
+#define vload(p)         _mm256_loadu_si256((const __m256i*)(p))
+#define vloadSpeed(p)    _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(p)))
+#define vstore(p, v)     _mm256_storeu_si256((__m256i*)(p), (v))
+#define vset1(v)         _mm256_set1_epi16(v)
+#define vzero()          _mm256_setzero_si256()
+#define vgt(a, b)        _mm256_cmpgt_epi16((a), (b))
+#define vand(a, b)       _mm256_and_si256((a), (b))
+#define vandnot(a, b)    _mm256_andnot_si256((a), (b))
+#define vor(a, b)        _mm256_or_si256((a), (b))
+#define vadd(a, b)       _mm256_add_epi16((a), (b))
+#define vsub(a, b)       _mm256_sub_epi16((a), (b))
+#define vmovemask(m)     (unsigned int)_mm256_movemask_epi8(m)
+#elif defined(__SSE2__)
+#define LANE_WIDTH_SIMD 8
+typedef __m128i vint;
+#define vload(p)         _mm_loadu_si128((const __m128i*)(p))
+#define vloadSpeed(p)    _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), _mm_setzero_si128())
+#define vstore(p, v)     _mm_storeu_si128((__m128i*)(p), (v))
+#define vset1(v)         _mm_set1_epi16(v)
+#define vzero()          _mm_setzero_si128()
+#define vgt(a, b)        _mm_cmpgt_epi16((a), (b))
+#define vand(a, b)       _mm_and_si128((a), (b))
+#define vandnot(a, b)    _mm_andnot_si128((a), (b))
+#define vor(a, b)        _mm_or_si128((a), (b))
+#define vadd(a, b)       _mm_add_epi16((a), (b))
+#define vsub(a, b)       _mm_sub_epi16((a), (b))
+#define vmovemask(m)     (unsigned int)_mm_movemask_epi8(m)
+#endif
+
+#ifdef LANE_WIDTH_SIMD
+// All-ones mask where value is short of the leg target
+static inline vint vbeforeTarget(vint value, const RouteLeg *leg) {
+    vint target = vset1(toFixed(leg->target));
+    return leg->direction > 0 ? vgt(target, value) : vgt(value, target);
+}
+
+// Moves the masked vehicles along a leg by their speed
+static inline void vadvance(vint *vx, vint *vy, const RouteLeg *leg, vint delta) {
+    vint *coord = leg->axis == AXIS_X ? vx : vy;
+    *coord = leg->direction > 0 ? vadd(*coord, delta) : vsub(*coord, delta);
+}
+
+// Vectorised kernel: the stop region and light are turned into lane masks
+// so a whole group of vehicles advances without per-vehicle branches.
+// Packed 16-bit positions put twice as many vehicles in each register.
+static int moveLaneSimd(const LaneRoute *route, bool lightRed, int16_t *x, int16_t *y,
+                        const uint8_t *speed, const int16_t *active, LaneGates gates,
+                        int16_t *exited, int count) {
+    const RouteLeg *first = &route->legs[0];
+    const RouteLeg *second = &route->legs[1];
+    const vint red = vset1(lightRed ? -1 : 0);
+    const vint minX = vset1(toFixed(route->stopMinX)), maxX = vset1(toFixed(route->stopMaxX));
+    const vint minY = vset1(toFixed(route->stopMinY)), maxY = vset1(toFixed(route->stopMaxY));
+    int moved = 0;
+    int i = 0;
+
+    for (; i + LANE_WIDTH_SIMD <= count; i += LANE_WIDTH_SIMD) {
+        vint vx = vload(x + i);
+        vint vy = vload(y + i);
+        vint live = vload(active + i);
+        vint vspeed = vloadSpeed(speed + i);
+
+        vint outside = vor(vor(vgt(minX, vx), vgt(vx, maxX)),
+                           vor(vgt(minY, vy), vgt(vy, maxY)));
+        vint stopped = vandnot(vload(gates.clearing + i), vandnot(outside, red));
+        vint canMove = vandnot(vor(vload(gates.hold + i), stopped), live);
+
+        vint c1 = first->axis == AXIS_X ? vx : vy;
+        vint c2 = second->axis == AXIS_X ? vx : vy;
+        vint onFirst = vand(vbeforeTarget(c1, first), canMove);
+        vint onSecond = second->direction != 0
+                        ? vandnot(onFirst, vand(vbeforeTarget(c2, second), canMove))
+                        : vzero();
+
+        vadvance(&vx, &vy, first, vand(onFirst, vspeed));
+        if (second->direction != 0) {
+            vadvance(&vx, &vy, second, vand(onSecond, vspeed));
+        }
+
+        vint exitCoord = route->exit.axis == AXIS_X ? vx : vy;
+        vint reached = vandnot(vbeforeTarget(exitCoord, &route->exit), live);
+
+        vstore(x + i, vx);
+        vstore(y + i, vy);
+        vstore(exited + i, reached);
+        // Byte mask: every moving 16-bit lane sets two bits
+        moved += __builtin_popcount(vmovemask(vor(onFirst, onSecond))) / 2;
+    }
+
+    LaneGates tail = {gates.hold + i, gates.clearing + i};
+    return moved + moveLaneScalar(route, lightRed, x + i, y + i, speed + i,
+                                  active + i, tail, exited + i, count - i);
+}
+#endif
+
+int moveLane(const LaneRoute *route, bool lightRed, int16_t *x, int16_t *y,
+             const uint8_t *speed, const int16_t *active, LaneGates gates,
+             int16_t *exited, int count) {
+#ifndef LANE_WIDTH_SIMD
+    return moveLaneScalar(route, lightRed, x, y, speed, active, gates, exited, count);
+#else
+#ifdef VERIFY_MOVEMENT
+    // Run the scalar path on copies and require a bit-exact match
+    size_t bytes = count * sizeof(int16_t);
+    int16_t *refX = malloc(bytes), *refY = malloc(bytes), *refExited = malloc(bytes);
+    memcpy(refX, x, bytes);
+    memcpy(refY, y, bytes);
+    int refMoved = moveLaneScalar(route, lightRed, refX, refY, speed, active, gates, refExited, count);
+#endif
+    int moved = moveLaneSimd(route, lightRed, x, y, speed, active, gates, exited, count);
+#ifdef VERIFY_MOVEMENT
+    if (moved != refMoved || memcmp(refX, x, bytes) != 0 ||
+        memcmp(refY, y, bytes) != 0 || memcmp(refExited, exited, bytes) != 0) {
+        fprintf(stderr, "Movement kernel mismatch against scalar path\n");
+        abort();
+    }
+    free(refX);
+    free(refY);
+    free(refExited);
+#endif
+    return moved;
+#endif
+}
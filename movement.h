@@ -0,0 +1,74 @@
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Vehicle positions are 12.4 fixed point (FIXED_ONE units per pixel) held in
+// int16_t, so they cover about -2048 to 2047 pixels; speeds use the same
+// units in a uint8_t. Route coordinates below stay in whole pixels.
+#define FIXED_ONE 16
+
+// Coordinate a route leg moves along
+typedef enum {
+    AXIS_X,
+    AXIS_Y
+} Axis;
+
+// Straight stretch of a route. A vehicle keeps moving along the axis while
+// its coordinate is short of the target in the given direction.
+typedef struct {
+    Axis axis;
+    int direction;  // +1 or -1, 0 if the leg is unused
+    int target;
+} RouteLeg;
+
+// Static description of how every vehicle in one lane moves
+typedef struct {
+    int spawnX;           // Position new vehicles appear at
+    int spawnY;
+    RouteLeg legs[2];     // Second leg is only taken once the first is done
+    RouteLeg exit;        // Vehicle has left the screen once past this target
+    int stopMinX;         // Region where a red light holds vehicles
+    int stopMaxX;
+    int stopMinY;
+    int stopMaxY;
+    int light;            // Index of the traffic light controlling the lane
+} LaneRoute;
+
+// Pixel coordinate to fixed point, saturated to the int16_t range so that
+// open-ended route bounds (INT_MIN / INT_MAX) stay open
+static inline int toFixed(int pixels) {
+    int64_t value = (int64_t)pixels * FIXED_ONE;
+    return value < INT16_MIN ? INT16_MIN : value > INT16_MAX ? INT16_MAX : (int)value;
+}
+
+// Per-vehicle masks (-1 set, 0 clear) supplied by the caller each step
+typedef struct {
+    const int16_t *hold;      // Must wait this step regardless of the light
+    const int16_t *clearing;  // Inside the intersection: ignores the light to clear it
+} LaneGates;
+
+// Movement kernel operations. Vehicles are stored as parallel arrays of
+// length count; active holds -1 for live slots and 0 for empty ones.
+// exited receives -1 for every live vehicle that reached the route exit.
+// Both return the number of vehicles that moved.
+int moveLane(const LaneRoute *route, bool lightRed, int16_t *x, int16_t *y,
+             const uint8_t *speed, const int16_t *active, LaneGates gates,
+             int16_t *exited, int count);
+int moveLaneScalar(const LaneRoute *route, bool lightRed, int16_t *x, int16_t *y,
+                   const uint8_t *speed, const int16_t *active, LaneGates gates,
+                   int16_t *exited, int count);
+
+// Unit step (-1, 0 or 1 per axis) a vehicle at fixed-point (x, y) takes
+// next along its route; both are 0 once the route is finished
+void routeDirection(const LaneRoute *route, int x, int y, int *dx, int *dy);
+
+// Whether a vehicle at fixed-point (x, y) is past the route exit
+bool routeExited(const LaneRoute *route, int x, int y);
+
+// Whether a vehicle at fixed-point (x, y) is in the region where a red
+// light holds it
+bool inStopRegion(const LaneRoute *route, int x, int y);
+
+#endif /* MOVEMENT_H */
@@ -0,0 +1,149 @@
+#include "plate.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT_EMPTY 0
+#define SLOT_TOMBSTONE UINT32_MAX  // Released ID; keeps probe chains intact
+
+// FNV-1a over the fixed-length plate
+static uint32_t hashPlate(const char *plate) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < PLATE_LENGTH && plate[i]; i++) {
+        hash = (hash ^ (unsigned char)plate[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool samePlate(const char *a, const char *b) {
+    return strncmp(a, b, PLATE_LENGTH) == 0;
+}
+
+// Slot holding the plate, or the slot it should be inserted into
+static uint32_t findSlot(const PlateTable *table, const char *plate, bool *found) {
+    uint32_t mask = table->slotCount - 1;
+    uint32_t insertAt = UINT32_MAX;
+    for (uint32_t i = hashPlate(plate) & mask;; i = (i + 1) & mask) {
+        uint32_t entry = table->slots[i];
+        if (entry == SLOT_EMPTY) {
+            *found = false;
+            return insertAt != UINT32_MAX ? insertAt : i;
+        }
+        if (entry == SLOT_TOMBSTONE) {
+            if (insertAt == UINT32_MAX) insertAt = i;
+        } else if (samePlate(table->plates[entry - 1], plate)) {
+            *found = true;
+            return i;
+        }
+    }
+}
+
+// Rebuild the hash with room for the live IDs, dropping tombstones
+static bool rehashPlates(PlateTable *table, uint32_t slotCount) {
+    uint32_t* slots = (uint32_t*)calloc(slotCount, sizeof(uint32_t));
+    if (!slots) return false;
+
+    free(table->slots);
+    table->slots = slots;
+    table->slotCount = slotCount;
+    table->usedSlots = 0;
+    for (uint32_t id = 0; id < table->count; id++) {
+        if (table->refs[id] == 0) continue;
+        bool found;
+        table->slots[findSlot(table, table->plates[id], &found)] = id + 1;
+        table->usedSlots++;
+    }
+    return true;
+}
+
+// Make room for one more ID
+static bool growPlates(PlateTable *table) {
+    uint32_t capacity = table->capacity * 2;
+    void* plates = realloc(table->plates, capacity * sizeof(*table->plates));
+    if (plates) table->plates = plates;
+    void* refs = realloc(table->refs, capacity * sizeof(uint32_t));
+    if (refs) table->refs = refs;
+    void* freeIds = realloc(table->freeIds, capacity * sizeof(uint32_t));
+    if (freeIds) table->freeIds = freeIds;
+    if (!plates || !refs || !freeIds) return false;
+
+    table->capacity = capacity;
+    return true;
+}
+
+// Plate table operations implementation
+bool initPlateTable(PlateTable *table, uint32_t capacity) {
+    memset(table, 0, sizeof(*table));
+    if (capacity < 16) capacity = 16;
+    table->capacity = capacity;
+    table->plates = malloc(capacity * sizeof(*table->plates));
+    table->refs = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    table->freeIds = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+
+    uint32_t slotCount = 16;
+    while (slotCount < capacity * 2) slotCount *= 2;
+    table->slots = (uint32_t*)calloc(slotCount, sizeof(uint32_t));
+    table->slotCount = slotCount;
+
+    if (!table->plates || !table->refs || !table->freeIds || !table->slots) {
+        freePlateTable(table);
+        return false;
+    }
+    return true;
+}
+
+void freePlateTable(PlateTable *table) {
+    free(table->plates);
+    free(table->refs);
+    free(table->freeIds);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+uint32_t internPlate(PlateTable *table, const char *plate) {
+    if (!table->slots) return PLATE_NONE;
+
+    bool found;
+    uint32_t slot = findSlot(table, plate, &found);
+    if (found) {
+        uint32_t id = table->slots[slot] - 1;
+        table->refs[id]++;
+        return id;
+    }
+
+    // Keep the hash at most half full, counting tombstones
+    if ((table->usedSlots + 1) * 2 > table->slotCount) {
+        uint32_t live = table->count - table->freeCount;
+        uint32_t slotCount = (live + 1) * 4 > table->slotCount ? table->slotCount * 2 : table->slotCount;
+        if (!rehashPlates(table, slotCount)) return PLATE_NONE;
+        slot = findSlot(table, plate, &found);
+    }
+
+    uint32_t id;
+    if (table->freeCount > 0) {
+        id = table->freeIds[--table->freeCount];
+    } else {
+        if (table->count == table->capacity && !growPlates(table)) return PLATE_NONE;
+        id = table->count++;
+    }
+
+    memset(table->plates[id], 0, sizeof(table->plates[id]));
+    strncpy(table->plates[id], plate, PLATE_LENGTH);
+    table->refs[id] = 1;
+    if (table->slots[slot] == SLOT_EMPTY) table->usedSlots++;
+    table->slots[slot] = id + 1;
+    return id;
+}
+
+void releasePlate(PlateTable *table, uint32_t id) {
+    if (id >= table->count || table->refs[id] == 0) return;
+    if (--table->refs[id] > 0) return;
+
+    bool found;
+    uint32_t slot = findSlot(table, table->plates[id], &found);
+    if (found) table->slots[slot] = SLOT_TOMBSTONE;
+    table->freeIds[table->freeCount++] = id;
+}
+
+const char* plateString(const PlateTable *table, uint32_t id) {
+    return id < table->count && table->refs[id] > 0 ? table->plates[id] : "";
+}
@@ -0,0 +1,32 @@
+#ifndef PLATE_H
+#define PLATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PLATE_LENGTH 8          // Characters in a vehicle number
+#define PLATE_NONE UINT32_MAX   // Returned when a plate could not be stored
+
+// Interns vehicle numbers so vehicles carry a 32-bit ID instead of the
+// string. Equal plates share one ID; IDs are reference counted and reused
+// once every vehicle holding them has been released.
+typedef struct {
+    char (*plates)[PLATE_LENGTH + 1];   // Plate string of each ID
+    uint32_t* refs;         // Live references per ID, 0 for free IDs
+    uint32_t* freeIds;      // Released IDs ready for reuse
+    uint32_t freeCount;
+    uint32_t count;         // IDs handed out so far
+    uint32_t capacity;      // IDs the arrays can hold
+    uint32_t* slots;        // Open-addressing hash of ID + 1 (0 empty)
+    uint32_t slotCount;     // Power of two
+    uint32_t usedSlots;     // Slots holding an ID or a tombstone
+} PlateTable;
+
+// Plate table operations
+bool initPlateTable(PlateTable *table, uint32_t capacity);
+void freePlateTable(PlateTable *table);
+uint32_t internPlate(PlateTable *table, const char *plate);
+void releasePlate(PlateTable *table, uint32_t id);
+const char* plateString(const PlateTable *table, uint32_t id);
+
+#endif /* PLATE_H */
@@ -1,27 +1,38 @@
 #include "queue.h"
+#include <stdlib.h>
 #include <string.h>
 
 // Queue operations implementation
-void initQueue(Queue *q) {
+void initQueue(Queue *q, int capacity) {
+    q->vehicles = (QueuedVehicle*)malloc(capacity * sizeof(QueuedVehicle));
+    q->capacity = q->vehicles ? capacity : 0;
     q->front = 0;
     q->rear = -1;
     q->size = 0;
 }
 
+void freeQueue(Queue *q) {
+    free(q->vehicles);
+    q->vehicles = NULL;
+    q->capacity = 0;
+    q->size = 0;
+}
+
 bool isQueueEmpty(Queue *q) {
     return q->size == 0;
 }
 
 bool isQueueFull(Queue *q) {
-    return q->size == MAX_QUEUE_SIZE;
+    return q->size == q->capacity;
 }
 
-void enqueue(Queue *q, QueuedVehicle v) {
-    if (isQueueFull(q)) return;
+bool enqueue(Queue *q, QueuedVehicle v) {
+    if (isQueueFull(q)) return false;
     
-    q->rear = (q->rear + 1) % MAX_QUEUE_SIZE;
+    q->rear = (q->rear + 1) % q->capacity;
     q->vehicles[q->rear] = v;
     q->size++;
+    return true;
 }
 
 QueuedVehicle dequeue(Queue *q) {
@@ -30,7 +41,7 @@ QueuedVehicle dequeue(Queue *q) {
     if (isQueueEmpty(q)) return v;
     
     v = q->vehicles[q->front];
-    q->front = (q->front + 1) % MAX_QUEUE_SIZE;
+    q->front = (q->front + 1) % q->capacity;
     q->size--;
     
     return v;
@@ -42,4 +53,4 @@ QueuedVehicle peek(Queue *q) {
     if (isQueueEmpty(q)) return v;
     
     return q->vehicles[q->front];
-}
\ No newline at end of file
+}
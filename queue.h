@@ -4,7 +4,7 @@
 #include <stdbool.h>
 
 // Queue related structures for vehicles
-#define MAX_QUEUE_SIZE 100
+#define MAX_QUEUE_SIZE 100  // Default queue capacity
 
 typedef struct {
     char number[9];
@@ -16,18 +16,20 @@ typedef struct {
 } QueuedVehicle;
 
 typedef struct {
-    QueuedVehicle vehicles[MAX_QUEUE_SIZE];
+    QueuedVehicle* vehicles;
+    int capacity;
     int front;
     int rear;
     int size;
 } Queue;
 
 // Queue operations
-void initQueue(Queue *q);
+void initQueue(Queue *q, int capacity);
+void freeQueue(Queue *q);
 bool isQueueEmpty(Queue *q);
 bool isQueueFull(Queue *q);
-void enqueue(Queue *q, QueuedVehicle v);
+bool enqueue(Queue *q, QueuedVehicle v);  // Returns false if the queue is full
 QueuedVehicle dequeue(Queue *q);
 QueuedVehicle peek(Queue *q);
 
-#endif /* QUEUE_H */
\ No newline at end of file
+#endif /* QUEUE_H */
@@ -0,0 +1,17 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Small random number generator (xorshift64*) whose whole state is one
+// integer, so it can be saved, restored and run as independent streams
+typedef struct {
+    uint64_t state;
+} Rng;
+
+// Random number generator operations
+void seedRng(Rng *rng, uint64_t seed);
+uint32_t nextRandom(Rng *rng);
+int randomRange(Rng *rng, int n);  // Uniform-ish integer in [0, n)
+
+#endif /* RNG_H */
@@ -0,0 +1,231 @@
+#include "signal_plan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Append a segment unless it is empty
+static void addSegment(SignalPlan *plan, uint32_t *time, uint32_t length, int phase,
+                       LightState interval, unsigned int lights, LightState groupState) {
+    if (length == 0) return;
+    SignalSegment* segment = &plan->segments[plan->segmentCount++];
+    segment->start = *time;
+    segment->phase = phase;
+    segment->interval = interval;
+    for (int i = 0; i < MAX_SIGNAL_LIGHTS; i++) {
+        segment->states[i] = (lights & (1u << i)) ? groupState : RED;
+    }
+    *time += length;
+}
+
+// Signal plan operations implementation
+void initSignalPlan(SignalPlan *plan, int lightCount) {
+    memset(plan, 0, sizeof(*plan));
+    plan->lightCount = lightCount < MAX_SIGNAL_LIGHTS ? lightCount : MAX_SIGNAL_LIGHTS;
+}
+
+bool addSignalPhase(SignalPlan *plan, unsigned int lights, uint32_t green, uint32_t amber, uint32_t allRed) {
+    if (plan->phaseCount == MAX_SIGNAL_PHASES) return false;
+    SignalPhase phase = {lights, green, amber, allRed};
+    plan->phases[plan->phaseCount++] = phase;
+    return true;
+}
+
+// Flatten the phases into segments and build the slot table. Slots are at
+// most as long as the shortest segment, so a slot holds at most one
+// transition and a lookup needs one table read and one comparison.
+bool compileSignalPlan(SignalPlan *plan) {
+    free(plan->slots);
+    plan->slots = NULL;
+    plan->segmentCount = 0;
+
+    uint32_t time = 0;
+    for (int p = 0; p < plan->phaseCount; p++) {
+        const SignalPhase* phase = &plan->phases[p];
+        addSegment(plan, &time, phase->green, p, GREEN, phase->lights, GREEN);
+        addSegment(plan, &time, phase->amber, p, AMBER, phase->lights, AMBER);
+        addSegment(plan, &time, phase->allRed, p, RED, 0, RED);
+    }
+    plan->cycle = time;
+    if (plan->segmentCount == 0) {
+        printf("Signal plan has no timed intervals\n");
+        return false;
+    }
+
+    uint32_t step = 0;
+    uint32_t shortest = UINT32_MAX;
+    for (int i = 0; i < plan->segmentCount; i++) {
+        uint32_t end = i + 1 < plan->segmentCount ? plan->segments[i + 1].start : plan->cycle;
+        uint32_t length = end - plan->segments[i].start;
+        step = gcd(step, length);
+        if (length < shortest) shortest = length;
+    }
+    // With the gcd every slot starts on a transition; if that makes the
+    // table too large, fall back to slots as long as the shortest segment
+    plan->slotMs = plan->cycle / step <= MAX_SIGNAL_SLOTS ? step : shortest;
+    if (plan->cycle / plan->slotMs > MAX_SIGNAL_SLOTS) {
+        printf("Signal plan intervals are too short for its %u ms cycle\n", plan->cycle);
+        return false;
+    }
+
+    plan->slotCount = (plan->cycle + plan->slotMs - 1) / plan->slotMs;
+    plan->slots = (uint16_t*)malloc(plan->slotCount * sizeof(uint16_t));
+    if (!plan->slots) return false;
+    int segment = 0;
+    for (int slot = 0; slot < plan->slotCount; slot++) {
+        uint32_t start = slot * plan->slotMs;
+        while (segment + 1 < plan->segmentCount && plan->segments[segment + 1].start <= start) {
+            segment++;
+        }
+        plan->slots[slot] = segment;
+    }
+    return true;
+}
+
+// Read a plan from a scenario file:
+//     # comment
+//     offset 0
+//     phase B2 D2 green 5000 amber 0 allred 0
+bool loadSignalPlan(SignalPlan *plan, const char *path, const char *const lightNames[], int lightCount) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Could not open signal plan %s\n", path);
+        return false;
+    }
+    initSignalPlan(plan, lightCount);
+
+    char line[256];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char* word = strtok(line, " \t\r\n");
+        if (!word) continue;
+
+        if (strcmp(word, "offset") == 0) {
+            char* value = strtok(NULL, " \t\r\n");
+            ok = value != NULL;
+            if (ok) plan->offset = strtoul(value, NULL, 10);
+        } else if (strcmp(word, "phase") == 0) {
+            unsigned int lights = 0;
+            uint32_t intervals[3] = {0, 0, 0};  // green, amber, all-red
+            while (ok && (word = strtok(NULL, " \t\r\n"))) {
+                int interval = strcmp(word, "green") == 0 ? 0 :
+                               strcmp(word, "amber") == 0 ? 1 :
+                               strcmp(word, "allred") == 0 ? 2 : -1;
+                if (interval >= 0) {
+                    char* value = strtok(NULL, " \t\r\n");
+                    ok = value != NULL;
+                    if (ok) intervals[interval] = strtoul(value, NULL, 10);
+                    continue;
+                }
+                int light = -1;
+                for (int i = 0; i < lightCount; i++) {
+                    if (strcmp(word, lightNames[i]) == 0) light = i;
+                }
+                ok = light >= 0;
+                if (ok) lights |= 1u << light;
+            }
+            ok = ok && addSignalPhase(plan, lights, intervals[0], intervals[1], intervals[2]);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            printf("%s:%d: invalid signal plan line\n", path, lineNumber);
+        }
+    }
+    fclose(file);
+    return ok && compileSignalPlan(plan);
+}
+
+void freeSignalPlan(SignalPlan *plan) {
+    free(plan->slots);
+    plan->slots = NULL;
+}
+
+const SignalSegment* signalSegmentAt(const SignalPlan *plan, uint32_t time) {
+    uint32_t cycleTime = time % plan->cycle;
+    int segment = plan->slots[cycleTime / plan->slotMs];
+    if (segment + 1 < plan->segmentCount && cycleTime >= plan->segments[segment + 1].start) {
+        segment++;
+    }
+    return &plan->segments[segment];
+}
+
+uint32_t nextSignalChange(const SignalPlan *plan, uint32_t time) {
+    uint32_t cycleTime = time % plan->cycle;
+    const SignalSegment* segment = signalSegmentAt(plan, time);
+    int index = segment - plan->segments;
+    uint32_t end = index + 1 < plan->segmentCount ? plan->segments[index + 1].start : plan->cycle;
+    return time + (end - cycleTime);
+}
+
+// Start, release or finish a preemption. A release waits until the group
+// has turned green, and a new request until the last release has cleared.
+void updatePreempt(const SignalPlan *plan, SignalPreempt *preempt, unsigned int group, bool wanted, uint32_t time) {
+    if (preempt->releasing && time >= preempt->clearEnd) {
+        memset(preempt, 0, sizeof(*preempt));
+    }
+
+    if (wanted && !preempt->group) {
+        const SignalSegment* segment = signalSegmentAt(plan, time);
+        const SignalPhase* phase = &plan->phases[segment->phase];
+        uint32_t remaining = nextSignalChange(plan, time) - time;
+        unsigned int lit = 0;
+        for (int i = 0; i < plan->lightCount; i++) {
+            if (segment->states[i] != RED) lit |= 1u << i;
+        }
+
+        preempt->group = group;
+        preempt->releasing = false;
+        preempt->amber = phase->amber;
+        preempt->allRed = phase->allRed;
+        if (segment->interval == GREEN) {
+            // Cut the green short; lights already green in the group stay so
+            preempt->giving = lit & ~group;
+            preempt->keep = lit & group;
+            preempt->amberEnd = preempt->giving ? time + phase->amber : time;
+            preempt->clearEnd = preempt->giving ? preempt->amberEnd + phase->allRed : time;
+        } else {
+            // Already clearing: let the amber and all-red run out
+            preempt->giving = lit;
+            preempt->keep = 0;
+            preempt->amberEnd = segment->interval == AMBER ? time + remaining : time;
+            preempt->clearEnd = segment->interval == AMBER ? preempt->amberEnd + phase->allRed
+                                                           : time + remaining;
+        }
+    } else if (!wanted && preempt->group && !preempt->releasing && time >= preempt->clearEnd) {
+        preempt->releasing = true;
+        preempt->giving = preempt->group;
+        preempt->keep = 0;
+        preempt->amberEnd = time + preempt->amber;
+        preempt->clearEnd = preempt->amberEnd + preempt->allRed;
+    }
+}
+
+void signalStates(const SignalPlan *plan, const SignalPreempt *preempt, uint32_t time, LightState states[]) {
+    if (!preempt->group) {
+        memcpy(states, signalSegmentAt(plan, time)->states, plan->lightCount * sizeof(LightState));
+        return;
+    }
+    for (int i = 0; i < plan->lightCount; i++) {
+        unsigned int bit = 1u << i;
+        if (time < preempt->amberEnd && (preempt->giving & bit)) {
+            states[i] = AMBER;
+        } else if (time < preempt->clearEnd || preempt->releasing) {
+            states[i] = (preempt->keep & bit) ? GREEN : RED;
+        } else {
+            states[i] = (preempt->group & bit) ? GREEN : RED;
+        }
+    }
+}
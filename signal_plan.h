@@ -0,0 +1,79 @@
+#ifndef SIGNAL_PLAN_H
+#define SIGNAL_PLAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_SIGNAL_LIGHTS 8
+#define MAX_SIGNAL_PHASES 16
+#define MAX_SIGNAL_SEGMENTS (MAX_SIGNAL_PHASES * 3)
+#define MAX_SIGNAL_SLOTS 65536      // Bounds the lookup table of a plan
+
+// Traffic light states. Amber is treated like red by vehicles.
+typedef enum {
+    RED,
+    GREEN,
+    AMBER
+} LightState;
+
+// One phase of a plan: a group of lights gets green, then amber, then every
+// light is red for a clearance interval. Intervals may be 0 to skip them.
+typedef struct {
+    unsigned int lights;    // Bit i set if light i is in the group
+    uint32_t green;         // Interval lengths in milliseconds
+    uint32_t amber;
+    uint32_t allRed;
+} SignalPhase;
+
+// Stretch of the cycle during which no light changes
+typedef struct {
+    uint32_t start;         // Milliseconds into the cycle
+    int phase;              // Phase the segment belongs to
+    LightState interval;    // Its green, amber or all-red (RED) interval
+    LightState states[MAX_SIGNAL_LIGHTS];
+} SignalSegment;
+
+// Signal plan: phase table plus the flat transition schedule compiled from
+// it. A compiled plan is read-only, so any number of intersections can
+// share one, each running it at its own offset.
+typedef struct {
+    int lightCount;
+    SignalPhase phases[MAX_SIGNAL_PHASES];
+    int phaseCount;
+    uint32_t offset;        // Default cycle offset for intersections using the plan
+    uint32_t cycle;         // Sum of every phase interval
+    SignalSegment segments[MAX_SIGNAL_SEGMENTS];
+    int segmentCount;
+    uint32_t slotMs;        // Cycle time covered by one lookup slot
+    uint16_t* slots;        // Segment in force at the start of every slot
+    int slotCount;
+} SignalPlan;
+
+// Preemption of a plan by a group of lights, such as a priority lane. The
+// phase in force when it is requested finishes through its amber and
+// all-red intervals before the group turns green; on release the group
+// clears through the same intervals and the plan takes over again.
+typedef struct {
+    unsigned int group;     // Lights given right of way, 0 while the plan runs
+    bool releasing;         // Group is clearing before the plan resumes
+    unsigned int giving;    // Lights amber until amberEnd
+    unsigned int keep;      // Lights left green through the clearance
+    uint32_t amberEnd;      // Plan times the clearance intervals end
+    uint32_t clearEnd;
+    uint32_t amber;         // Clearance intervals used on release
+    uint32_t allRed;
+} SignalPreempt;
+
+// Signal plan operations. Times passed to the lookups already include the
+// intersection's offset.
+void initSignalPlan(SignalPlan *plan, int lightCount);
+bool addSignalPhase(SignalPlan *plan, unsigned int lights, uint32_t green, uint32_t amber, uint32_t allRed);
+bool compileSignalPlan(SignalPlan *plan);
+bool loadSignalPlan(SignalPlan *plan, const char *path, const char *const lightNames[], int lightCount);
+void freeSignalPlan(SignalPlan *plan);
+const SignalSegment* signalSegmentAt(const SignalPlan *plan, uint32_t time);
+uint32_t nextSignalChange(const SignalPlan *plan, uint32_t time);  // Absolute time of the next transition
+void updatePreempt(const SignalPlan *plan, SignalPreempt *preempt, unsigned int group, bool wanted, uint32_t time);
+void signalStates(const SignalPlan *plan, const SignalPreempt *preempt, uint32_t time, LightState states[]);
+
+#endif /* SIGNAL_PLAN_H */
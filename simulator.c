@@ -5,7 +5,19 @@
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
+#include <limits.h>
 #include "queue.h"  // Include the queue header
+#include "event.h"  // Discrete-event scheduling
+#include "movement.h"  // Lane movement kernel
+#include "rng.h"  // Saveable random number generator
+#include "density.h"  // Heatmap for large vehicle counts
+#include "plate.h"  // Interned vehicle numbers
+#include "ingest.h"  // Background reader for the generator's lane files
+#include "telemetry.h"  // Live stats over a UNIX socket
+#include "signal_plan.h"  // Phase tables driving the traffic lights
+#include "grid.h"  // Intersection occupancy for conflict gating
+#include "capture.h"  // Offscreen frame recording
+#include "trace.h"  // Scoped zone tracing (make TRACE=1)
 
 const int SCREEN_WIDTH = 1000;  // Increased screen width (wider screen)
 const int SCREEN_HEIGHT = 800;  // Keeping the same height
@@ -13,42 +25,86 @@ const int SCREEN_HEIGHT = 800;  // Keeping the same height
 // Lane width for each lane
 const int LANE_WIDTH = SCREEN_WIDTH / 9;
 
+// Width and height of a vehicle
+const int VEHICLE_SIZE = 40;
+
+// Simulation time advanced per fixed step, independent of the render rate
+const Uint32 SIM_STEP_MS = 16;
+
+// Frame pacing: target frame time when vsync is unavailable, and the longest
+// frame the simulation tries to catch up on (avoids a spiral after stalls)
+const double TARGET_FRAME_MS = 1000.0 / 60.0;
+const double MAX_FRAME_MS = 250.0;
+
+// Level of detail: above lodThreshold vehicles the scene draws a density
+// heatmap of DENSITY_CELL_SIZE cells, unless zoomed in to LOD_ZOOM or closer
+const int DEFAULT_LOD_THRESHOLD = 1000;
+const int DENSITY_CELL_SIZE = 8;
+const float LOD_ZOOM = 2.0f;
+const float MAX_ZOOM = 8.0f;
+
+// Frame buffers in flight between the render loop and the capture writer;
+// bounds capture memory at this many full frames
+const int DEFAULT_CAPTURE_BUFFERS = 8;
+
+// Ingested batches moved into lane backlogs per simulation step, which keeps
+// the cost of a step flat however large a burst the generator writes
+const int INGEST_BATCHES_PER_STEP = 4;
+
+// Default time between telemetry samples sent to subscribers (milliseconds)
+const int DEFAULT_TELEMETRY_INTERVAL_MS = 250;
+
+// Default time between generated arrivals per queue target (milliseconds):
+// D3, B3, C3, A3, then A2, B2, C2, D2
+const Uint32 DEFAULT_GENERATION_INTERVALS[8] = {3000, 4000, 3500, 4500, 2000, 2500, 3000, 3500};
+
+// Conflict gating: the intersection box is tracked in cells of
+// CONFLICT_CELL_SIZE pixels, and a vehicle about to enter it checks its
+// whole path through the box against the paths other lanes have reserved
+const int CONFLICT_CELL_SIZE = 20;
+
+// How far past its stop line a vehicle must be before it counts as inside
+// the intersection. More than one step, so vehicles waiting at the line
+// (some of which already overlap the box) never do.
+const int STOP_LINE_CLEARANCE = 20;
+
+// Snapshot file format version; bump whenever the saved state changes
+const uint32_t SNAPSHOT_VERSION = 7;
+
 // Lane division colors (light and subtle)
 SDL_Color laneDivisionColor = {180, 180, 180, 255};  // Light gray for subtle divisions
 
-// Traffic light states
-typedef enum {
-    RED,
-    GREEN
-} LightState;
-
 // Traffic light structure
 typedef struct {
     int x;
     int y;
     int radius;
-    LightState state;
-    Uint32 lastToggleTime;  // Time when last toggled
-    Uint32 duration;        // Duration before next toggle (in milliseconds)
+    LightState state;       // Set every step from the signal plan
     bool isPriority;        // Flag to indicate if this lane has priority
 } TrafficLight;
 
-// Vehicle structure to hold properties of a vehicle
+// Cold per-vehicle data, only touched when a vehicle enters, leaves or is
+// drawn. Position, speed and visibility live in the packed parallel arrays
+// of its VehicleQueue, and road and lane are the queue's own.
 typedef struct {
-    SDL_Rect rect;  // Rectangle for the vehicle (position and size)
-    int speed;      // Speed of the vehicle
-    int targetX;    // Target X position (destination)
-    int targetY;    // Target Y position (destination)
-    bool active;    // Whether vehicle is active/visible
-    char road;      // Road identifier (A, B, C, D)
-    int lane;       // Lane number (1, 2, 3)
+    uint32_t plate;  // Interned vehicle number (see plate.h)
     bool isPriority; // Whether this vehicle is in a priority lane
-    char number[9]; // Vehicle number for identification
 } Vehicle;
 
 // Queue structure for vehicle generation
 typedef struct {
     Vehicle* vehicles;
+    int16_t* x;     // X position of each slot's vehicle (12.4 fixed point)
+    int16_t* y;     // Y position of each slot's vehicle (12.4 fixed point)
+    int16_t* prevX; // Positions before the last step, for render interpolation
+    int16_t* prevY;
+    uint8_t* speed; // Speed of each slot's vehicle, fixed point per step
+    int16_t* active; // -1 while the slot holds a visible vehicle, 0 otherwise
+    int16_t* exited; // Set by the movement kernel for vehicles past the exit
+    int16_t* hold;     // -1 for vehicles waiting for their path through the intersection to clear
+    int16_t* clearing; // -1 for vehicles inside the intersection, which never stop there
+    bool* reserved;    // Holds a reservation of its path through the intersection
+    const LaneRoute* route; // How vehicles in this lane move
     int capacity;
     int size;
     int front;
@@ -57,10 +113,52 @@ typedef struct {
     Uint32 generationInterval;
     char road;      // Road identifier for this queue
     int lane;       // Lane number for this queue
+    Queue backlog;          // Arrivals waiting for room in the visible lane
+    unsigned int served;    // Vehicles that reached their destination
+    unsigned int deferred;  // Arrivals that had to wait in the backlog
+    unsigned int dropped;   // Arrivals lost because the backlog was full
 } VehicleQueue;
 
+// Complete simulation state advanced by stepSimulation. Queue targets 0-3
+// are the incoming lanes and 4-7 the middle lanes.
+typedef struct {
+    TrafficLight lights[4];         // A2, B2, C2, D2 lights
+    const SignalPlan* plan;         // Signal timing, possibly shared with other intersections
+    Uint32 signalOffset;            // Where this intersection runs in the plan's cycle
+    SignalPreempt preempt;          // A2 priority layered over the plan
+    LaneRoute routes[8];
+    VehicleQueue incoming[4];       // D3, B3, C3, A3
+    VehicleQueue middle[4];         // A2, B2, C2, D2
+    EventQueue events;
+    SpatialGrid grid;               // Intersection occupancy, rebuilt every step
+    Rng rng;                        // Random stream for vehicle numbers
+    PlateTable plates;              // Vehicle numbers of every lane vehicle
+    Ingest* ingest;                 // Arrivals read from the lane files, or NULL
+    unsigned int ignoredArrivals;   // Ingested vehicles for lanes that have no queue
+    Uint32 simTime;                 // Simulation clock (milliseconds)
+} Simulation;
+
+// Smoothed timing counters for the main loop (milliseconds)
+typedef struct {
+    double frameMs;         // Time between consecutive frames
+    double stepMs;          // Time spent in one simulation step
+    int stepsPerFrame;      // Simulation steps run during the last frame
+    Uint32 lastReportTime;  // When the counters were last shown
+} FrameStats;
+
+// How the scene is drawn
+typedef struct {
+    float zoom;             // 1 shows the whole intersection; larger zooms into its centre
+    int lodThreshold;       // Vehicle count above which the heatmap replaces sprites
+    DensityMap density;
+    bool hasDensity;        // False if the heatmap texture could not be created
+    SDL_Rect* rects;        // Scratch buffer for batched vehicle drawing
+    int rectCapacity;
+} RenderView;
+
 // Declare the drawCircle function
 void drawCircle(SDL_Renderer *renderer, int centerX, int centerY, int radius) {
+    TRACE_ZONE("drawCircle");
     // Draw a circle using the midpoint circle algorithm
     for (int w = 0; w < 360; w++) {
         int x = (int)(centerX + radius * cos(w * M_PI / 180.0));
@@ -70,57 +168,64 @@ void drawCircle(SDL_Renderer *renderer, int centerX, int centerY, int radius) {
 }
 
 // Initialize traffic light
-TrafficLight initTrafficLight(int x, int y, int radius, LightState initialState, Uint32 duration) {
+TrafficLight initTrafficLight(int x, int y, int radius) {
     TrafficLight light;
     light.x = x;
     light.y = y;
     light.radius = radius;
-    light.state = initialState;
-    light.lastToggleTime = SDL_GetTicks();
-    light.duration = duration;
+    light.state = RED;
     light.isPriority = false;
     return light;
 }
 
-// Toggle traffic light state
-void toggleTrafficLight(TrafficLight* light) {
-    if (light->state == RED) {
-        light->state = GREEN;
-    } else {
-        light->state = RED;
-    }
-    light->lastToggleTime = SDL_GetTicks();
-}
-
-// Update traffic light state based on time
-void updateTrafficLight(TrafficLight* light) {
-    Uint32 currentTime = SDL_GetTicks();
-    if (currentTime - light->lastToggleTime >= light->duration) {
-        toggleTrafficLight(light);
-    }
-}
-
 // Initialize vehicle queue
-VehicleQueue initVehicleQueue(int capacity, Uint32 generationInterval, char road, int lane) {
+VehicleQueue initVehicleQueue(int capacity, int backlogCapacity, Uint32 generationInterval,
+                              char road, int lane, const LaneRoute* route) {
     VehicleQueue queue;
     queue.capacity = capacity;
     queue.vehicles = (Vehicle*)malloc(capacity * sizeof(Vehicle));
+    queue.x = (int16_t*)malloc(capacity * sizeof(int16_t));
+    queue.y = (int16_t*)malloc(capacity * sizeof(int16_t));
+    queue.prevX = (int16_t*)malloc(capacity * sizeof(int16_t));
+    queue.prevY = (int16_t*)malloc(capacity * sizeof(int16_t));
+    queue.speed = (uint8_t*)malloc(capacity * sizeof(uint8_t));
+    queue.active = (int16_t*)calloc(capacity, sizeof(int16_t));  // All vehicles start inactive
+    queue.exited = (int16_t*)calloc(capacity, sizeof(int16_t));
+    queue.hold = (int16_t*)calloc(capacity, sizeof(int16_t));
+    queue.clearing = (int16_t*)calloc(capacity, sizeof(int16_t));
+    queue.reserved = (bool*)calloc(capacity, sizeof(bool));
+    queue.route = route;
     queue.size = 0;
     queue.front = 0;
     queue.rear = -1;
-    queue.lastGenerationTime = SDL_GetTicks();
+    queue.lastGenerationTime = 0;
     queue.generationInterval = generationInterval;
     queue.road = road;
     queue.lane = lane;
-    
-    // Initialize all vehicles as inactive
-    for (int i = 0; i < capacity; i++) {
-        queue.vehicles[i].active = false;
-    }
+    initQueue(&queue.backlog, backlogCapacity);
+    queue.served = 0;
+    queue.deferred = 0;
+    queue.dropped = 0;
     
     return queue;
 }
 
+// Free the storage owned by a vehicle queue
+void freeVehicleQueue(VehicleQueue* queue) {
+    free(queue->vehicles);
+    free(queue->x);
+    free(queue->y);
+    free(queue->prevX);
+    free(queue->prevY);
+    free(queue->speed);
+    free(queue->active);
+    free(queue->exited);
+    free(queue->hold);
+    free(queue->clearing);
+    free(queue->reserved);
+    freeQueue(&queue->backlog);
+}
+
 // Add vehicle to queue
 bool enqueueVehicle(VehicleQueue* queue, Vehicle vehicle) {
     if (queue->size == queue->capacity) {
@@ -129,129 +234,139 @@ bool enqueueVehicle(VehicleQueue* queue, Vehicle vehicle) {
     
     queue->rear = (queue->rear + 1) % queue->capacity;
     queue->vehicles[queue->rear] = vehicle;
+    queue->x[queue->rear] = toFixed(queue->route->spawnX);
+    queue->y[queue->rear] = toFixed(queue->route->spawnY);
+    queue->prevX[queue->rear] = queue->x[queue->rear];
+    queue->prevY[queue->rear] = queue->y[queue->rear];
+    queue->speed[queue->rear] = 4 * FIXED_ONE;  // Default speed
+    queue->active[queue->rear] = -1;
+    queue->reserved[queue->rear] = false;
     queue->size++;
     return true;
 }
 
-// Remove vehicle from queue
-bool dequeueVehicle(VehicleQueue* queue, Vehicle* vehicle) {
-    if (queue->size == 0) {
-        return false;  // Queue is empty
+// Returns true if a vehicle can enter the lane without landing on top of the
+// one that entered before it
+bool spawnPointClear(VehicleQueue* queue) {
+    if (queue->size == queue->capacity) {
+        return false;
+    }
+    if (queue->size == 0 || !queue->active[queue->rear]) {
+        return true;
+    }
+    return abs(queue->x[queue->rear] - toFixed(queue->route->spawnX)) >= toFixed(VEHICLE_SIZE) ||
+           abs(queue->y[queue->rear] - toFixed(queue->route->spawnY)) >= toFixed(VEHICLE_SIZE);
+}
+
+// Turn a backlog entry into a lane vehicle, interning its number
+Vehicle fromQueuedVehicle(QueuedVehicle queued, PlateTable* plates) {
+    Vehicle vehicle;
+    vehicle.plate = internPlate(plates, queued.number);
+    vehicle.isPriority = queued.priority != 0;
+    return vehicle;
+}
+
+// Hand an arriving vehicle to the lane. If the lane cannot take it yet it
+// waits in the backlog, and only when the backlog is full is it dropped.
+void arriveVehicle(VehicleQueue* queue, PlateTable* plates, QueuedVehicle arrival) {
+    if (isQueueEmpty(&queue->backlog) && spawnPointClear(queue)) {
+        enqueueVehicle(queue, fromQueuedVehicle(arrival, plates));
+    } else if (enqueue(&queue->backlog, arrival)) {
+        queue->deferred++;
+    } else {
+        queue->dropped++;
+    }
+}
+
+// Move waiting vehicles from the backlog into the lane as room frees up
+void admitBacklog(VehicleQueue* queue, PlateTable* plates) {
+    while (!isQueueEmpty(&queue->backlog) && spawnPointClear(queue)) {
+        enqueueVehicle(queue, fromQueuedVehicle(dequeue(&queue->backlog), plates));
+    }
+}
+
+// Release finished vehicles from the front of the queue so their slots can be reused
+void retireVehicles(VehicleQueue* queue) {
+    while (queue->size > 0 && !queue->active[queue->front]) {
+        queue->front = (queue->front + 1) % queue->capacity;
+        queue->size--;
     }
-    
-    *vehicle = queue->vehicles[queue->front];
-    queue->vehicles[queue->front].active = false;
-    queue->front = (queue->front + 1) % queue->capacity;
-    queue->size--;
-    return true;
 }
 
 // Generate a random vehicle number
-void generateVehicleNumber(char* buffer) {
-    buffer[0] = 'A' + rand() % 26;
-    buffer[1] = 'A' + rand() % 26;
-    buffer[2] = '0' + rand() % 10;
-    buffer[3] = 'A' + rand() % 26;
-    buffer[4] = 'A' + rand() % 26;
-    buffer[5] = '0' + rand() % 10;
-    buffer[6] = '0' + rand() % 10;
-    buffer[7] = '0' + rand() % 10;
+void generateVehicleNumber(char* buffer, Rng* rng) {
+    buffer[0] = 'A' + randomRange(rng, 26);
+    buffer[1] = 'A' + randomRange(rng, 26);
+    buffer[2] = '0' + randomRange(rng, 10);
+    buffer[3] = 'A' + randomRange(rng, 26);
+    buffer[4] = 'A' + randomRange(rng, 26);
+    buffer[5] = '0' + randomRange(rng, 10);
+    buffer[6] = '0' + randomRange(rng, 10);
+    buffer[7] = '0' + randomRange(rng, 10);
     buffer[8] = '\0';
 }
 
-// Function to generate vehicles for middle lanes
-void generateMiddleLaneVehicles(VehicleQueue* queues, int queueCount) {
-    Uint32 currentTime = SDL_GetTicks();
-    
-    for (int i = 0; i < queueCount; i++) {
-        if (currentTime - queues[i].lastGenerationTime >= queues[i].generationInterval) {
-            // Generate vehicle for middle lane
-            Vehicle newVehicle;
-            newVehicle.active = true;
-            newVehicle.speed = 4;
-            newVehicle.road = queues[i].road;
-            newVehicle.lane = queues[i].lane;
-            newVehicle.isPriority = (newVehicle.road == 'A' && newVehicle.lane == 2); // A2 is priority lane
-            generateVehicleNumber(newVehicle.number);
-            
-            // Initialize position based on which middle lane
-            switch (queues[i].road) {
-                case 'A':  // A2 Middle Lane (Top vertical)
-                    newVehicle.rect = (SDL_Rect){SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 20, 0 - 40, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 20;
-                    newVehicle.targetY = SCREEN_HEIGHT / 3 - 50;
-                    break;
-                case 'B':  // B2 Middle Lane (Bottom vertical)
-                    newVehicle.rect = (SDL_Rect){SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 20, SCREEN_HEIGHT + 40, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 20;
-                    newVehicle.targetY = SCREEN_HEIGHT * 2 / 3 + 50;
-                    break;
-                case 'C':  // C2 Middle Lane (Right horizontal)
-                    newVehicle.rect = (SDL_Rect){SCREEN_WIDTH + 40, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 20, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH * 2 / 3 + 50;
-                    newVehicle.targetY = SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 20;
-                    break;
-                case 'D':  // D2 Middle Lane (Left horizontal)
-                    newVehicle.rect = (SDL_Rect){0 - 40, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 20, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH / 3 - 50;
-                    newVehicle.targetY = SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 20;
-                    break;
-            }
-            
-            enqueueVehicle(&queues[i], newVehicle);
-            queues[i].lastGenerationTime = currentTime;
-        }
-    }
+// Function to generate a vehicle for a lane; its starting position comes from the lane route
+void generateVehicle(VehicleQueue* queue, PlateTable* plates, Rng* rng, Uint32 simTime) {
+    TRACE_ZONE("generateVehicle");
+    QueuedVehicle newVehicle = {"", queue->road, queue->lane, 0, '\0', 0};
+    newVehicle.priority = (newVehicle.road == 'A' && newVehicle.lane == 2); // A2 is priority lane
+    generateVehicleNumber(newVehicle.number, rng);
+    
+    arriveVehicle(queue, plates, newVehicle);
+    queue->lastGenerationTime = simTime;
 }
 
-// Function to generate vehicles for incoming lanes
-void generateVehicles(VehicleQueue* queues, int queueCount) {
-    Uint32 currentTime = SDL_GetTicks();
+// Build a route leg
+RouteLeg routeLeg(Axis axis, int direction, int target) {
+    RouteLeg leg = {axis, direction, target};
+    return leg;
+}
+
+// Describe how vehicles move in every lane. Routes 0-3 are the incoming
+// lanes (D3, B3, C3, A3) and 4-7 the middle lanes (A2, B2, C2, D2).
+void initLaneRoutes(LaneRoute routes[]) {
+    const RouteLeg none = routeLeg(AXIS_X, 0, 0);
+    const int middle = SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 20;  // Middle lane offset
+    const int middleRow = SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 20;
     
-    for (int i = 0; i < queueCount; i++) {
-        if (currentTime - queues[i].lastGenerationTime >= queues[i].generationInterval) {
-            // Generate vehicle based on which queue (road)
-            Vehicle newVehicle;
-            newVehicle.active = true;
-            newVehicle.speed = 4;  // Default speed
-            generateVehicleNumber(newVehicle.number);
-            
-            switch (i) {
-                case 0:  // D3 to A1
-                    newVehicle.rect = (SDL_Rect){0 - 40, SCREEN_HEIGHT / 3 + LANE_WIDTH / 3, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH / 3 + LANE_WIDTH / 4;
-                    newVehicle.targetY = -40;
-                    newVehicle.road = 'D';
-                    newVehicle.lane = 3;
-                    break;
-                case 1:  // B3 to D1
-                    newVehicle.rect = (SDL_Rect){SCREEN_WIDTH / 3 + LANE_WIDTH / 4, SCREEN_HEIGHT + 40, 40, 40};
-                    newVehicle.targetX = -40;
-                    newVehicle.targetY = SCREEN_HEIGHT / 1.55;
-                    newVehicle.road = 'B';
-                    newVehicle.lane = 3;
-                    break;
-                case 2:  // C3 to B1
-                    newVehicle.rect = (SDL_Rect){SCREEN_WIDTH, SCREEN_HEIGHT / 3 + 2.4 * LANE_WIDTH, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH / 1.69;
-                    newVehicle.targetY = SCREEN_HEIGHT;
-                    newVehicle.road = 'C';
-                    newVehicle.lane = 3;
-                    break;
-                case 3:  // A3 to C1
-                    newVehicle.rect = (SDL_Rect){SCREEN_WIDTH / 3 + 2.4 * LANE_WIDTH, 0, 40, 40};
-                    newVehicle.targetX = SCREEN_WIDTH;
-                    newVehicle.targetY = SCREEN_HEIGHT / 2.8;
-                    newVehicle.road = 'A';
-                    newVehicle.lane = 3;
-                    break;
-            }
-            
-            newVehicle.isPriority = false;  // Incoming lanes are not priority
-            enqueueVehicle(&queues[i], newVehicle);
-            queues[i].lastGenerationTime = currentTime;
-        }
-    }
+    // D3 to A1: right along D3, then up past A1 (stops for A2 light)
+    routes[0] = (LaneRoute){0 - 40, SCREEN_HEIGHT / 3 + LANE_WIDTH / 3,
+                            {routeLeg(AXIS_X, 1, SCREEN_WIDTH / 3 + LANE_WIDTH / 4), routeLeg(AXIS_Y, -1, -40)},
+                            routeLeg(AXIS_Y, -1, 0),
+                            SCREEN_WIDTH / 3 - VEHICLE_SIZE, INT_MAX, INT_MIN, SCREEN_HEIGHT / 3 + LANE_WIDTH, 0};
+    // B3 to D1: up along B3, then left past D1 (stops for D2 light)
+    routes[1] = (LaneRoute){SCREEN_WIDTH / 3 + LANE_WIDTH / 4, SCREEN_HEIGHT + 40,
+                            {routeLeg(AXIS_Y, -1, SCREEN_HEIGHT / 1.55), routeLeg(AXIS_X, -1, -40)},
+                            routeLeg(AXIS_X, -1, 0),
+                            INT_MIN, SCREEN_WIDTH / 3 + LANE_WIDTH, INT_MIN, SCREEN_HEIGHT / 3 + 2 * LANE_WIDTH, 3};
+    // C3 to B1: west along C3, then south past B1 (stops for B2 light)
+    routes[2] = (LaneRoute){SCREEN_WIDTH, SCREEN_HEIGHT / 3 + 2.4 * LANE_WIDTH,
+                            {routeLeg(AXIS_X, -1, SCREEN_WIDTH / 1.69), routeLeg(AXIS_Y, 1, SCREEN_HEIGHT)},
+                            routeLeg(AXIS_Y, 1, SCREEN_HEIGHT),
+                            INT_MIN, SCREEN_WIDTH * 2 / 3 + VEHICLE_SIZE, SCREEN_HEIGHT / 3 - VEHICLE_SIZE, INT_MAX, 1};
+    // A3 to C1: south along A3, then east past C1 (stops for C2 light)
+    routes[3] = (LaneRoute){SCREEN_WIDTH / 3 + 2.4 * LANE_WIDTH, 0,
+                            {routeLeg(AXIS_Y, 1, SCREEN_HEIGHT / 2.8), routeLeg(AXIS_X, 1, SCREEN_WIDTH)},
+                            routeLeg(AXIS_X, 1, SCREEN_WIDTH),
+                            SCREEN_WIDTH / 3 + 2 * LANE_WIDTH, INT_MAX, SCREEN_HEIGHT / 3 - VEHICLE_SIZE, INT_MAX, 2};
+    
+    // A2 to B2: straight down
+    routes[4] = (LaneRoute){middle, 0 - 40, {routeLeg(AXIS_Y, 1, SCREEN_HEIGHT), none},
+                            routeLeg(AXIS_Y, 1, SCREEN_HEIGHT),
+                            INT_MIN, INT_MAX, SCREEN_HEIGHT / 3 - VEHICLE_SIZE, INT_MAX, 0};
+    // B2 to A2: straight up
+    routes[5] = (LaneRoute){middle, SCREEN_HEIGHT + 40, {routeLeg(AXIS_Y, -1, 0), none},
+                            routeLeg(AXIS_Y, -1, 0),
+                            INT_MIN, INT_MAX, INT_MIN, SCREEN_HEIGHT * 2 / 3, 1};
+    // C2 to D2: straight left
+    routes[6] = (LaneRoute){SCREEN_WIDTH + 40, middleRow, {routeLeg(AXIS_X, -1, 0), none},
+                            routeLeg(AXIS_X, -1, 0),
+                            INT_MIN, SCREEN_WIDTH * 2 / 3, INT_MIN, INT_MAX, 2};
+    // D2 to C2: straight right
+    routes[7] = (LaneRoute){0 - 40, middleRow, {routeLeg(AXIS_X, 1, SCREEN_WIDTH), none},
+                            routeLeg(AXIS_X, 1, SCREEN_WIDTH),
+                            SCREEN_WIDTH / 3, INT_MAX, INT_MIN, INT_MAX, 3};
 }
 
 // Function to draw individual lane divisions without crossing stop lines
@@ -303,10 +418,13 @@ void drawCrossroad(SDL_Renderer *renderer) {
 
 // Function to draw traffic lights for all middle lanes (A2, B2, C2, D2)
 void drawTrafficLights(SDL_Renderer *renderer, TrafficLight lights[], int lightCount) {
+    TRACE_ZONE("drawTrafficLights");
     for (int i = 0; i < lightCount; i++) {
         // Set color based on traffic light state
         if (lights[i].state == RED) {
             SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);  // Red
+        } else if (lights[i].state == AMBER) {
+            SDL_SetRenderDrawColor(renderer, 255, 190, 0, 255);  // Amber
         } else {
             SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);  // Green
         }
@@ -317,6 +435,7 @@ void drawTrafficLights(SDL_Renderer *renderer, TrafficLight lights[], int lightC
 
 // Function to render text (lane names)
 void renderText(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color) {
+    TRACE_ZONE("renderText");
     SDL_Surface *textSurface = TTF_RenderText_Solid(font, text, color);
     SDL_Texture *textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
     SDL_Rect textRect = {x, y, textSurface->w, textSurface->h};
@@ -325,200 +444,1029 @@ void renderText(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x,
     SDL_DestroyTexture(textTexture);
 }
 
-// Function to draw the vehicle (simple rectangle for now)
-void drawVehicle(SDL_Renderer *renderer, Vehicle *vehicle) {
-    if (vehicle->active) {
-        if (vehicle->isPriority) {
-            SDL_SetRenderDrawColor(renderer, 255, 165, 0, 255);  // Orange for priority vehicles
-        } else {
-            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);  // Red color for the vehicle
+// Interpolated on-screen rectangle of the vehicle in a queue slot.
+// alpha blends between the previous and current step positions.
+SDL_Rect vehicleRect(VehicleQueue *queue, int slot, float alpha) {
+    int x = lroundf((queue->prevX[slot] + (queue->x[slot] - queue->prevX[slot]) * alpha) / FIXED_ONE);
+    int y = lroundf((queue->prevY[slot] + (queue->y[slot] - queue->prevY[slot]) * alpha) / FIXED_ONE);
+    SDL_Rect rect = {x, y, VEHICLE_SIZE, VEHICLE_SIZE};
+    return rect;
+}
+
+// Advance every vehicle of a lane by one step and schedule exits for those
+// that left the screen. Returns the number of vehicles that moved.
+int moveQueueVehicles(VehicleQueue* queue, int target, TrafficLight* trafficLights,
+                      EventQueue* events, Uint32 simTime) {
+    bool lightRed = trafficLights[queue->route->light].state != GREEN;  // Amber stops too
+    LaneGates gates = {queue->hold, queue->clearing};
+    int moved = moveLane(queue->route, lightRed, queue->x, queue->y, queue->speed,
+                         queue->active, gates, queue->exited, queue->capacity);
+    
+    // Check if vehicles reached their destination
+    for (int j = 0; j < queue->capacity; j++) {
+        if (queue->exited[j]) {
+            scheduleEvent(events, simTime, EVENT_LANE_EXIT, target, j);
         }
-        SDL_RenderFillRect(renderer, &vehicle->rect);  // Draw the vehicle rectangle
     }
+    return moved;
 }
 
-// Movement functions for incoming lanes
-void moveVehicleD3toA1(Vehicle *vehicle, TrafficLight *a2Light) {
-    // Check if at intersection and if the light is red
-    bool atIntersection = (vehicle->rect.x >= SCREEN_WIDTH / 3 - vehicle->rect.w && 
-                          vehicle->rect.y <= SCREEN_HEIGHT / 3 + LANE_WIDTH);
+// Set the lights from the signal plan, with A2 priority running through
+// it: while A2 has more than 5 vehicles the plan is preempted, the phase
+// in force clearing through its amber and all-red before A2 turns green
+// and every other light red
+void updateSignals(Simulation* sim) {
+    Uint32 planTime = sim->simTime + sim->signalOffset;
+    SignalPreempt before = sim->preempt;
+    updatePreempt(sim->plan, &sim->preempt, 1u << 0, sim->middle[0].size > 5, planTime);
     
-    if (atIntersection && a2Light->state == RED) {
-        return;  // Stop at red light
+    // Make sure a step runs at the end of every clearance interval
+    if (sim->preempt.group &&
+        (sim->preempt.clearEnd != before.clearEnd || sim->preempt.releasing != before.releasing)) {
+        scheduleEvent(&sim->events, sim->preempt.amberEnd - sim->signalOffset, EVENT_PHASE_CHANGE, 1, 0);
+        scheduleEvent(&sim->events, sim->preempt.clearEnd - sim->signalOffset, EVENT_PHASE_CHANGE, 1, 0);
     }
     
-    if (vehicle->rect.x < vehicle->targetX) {
-        vehicle->rect.x += vehicle->speed;  // Move right
-    } else if (vehicle->rect.y > vehicle->targetY) {
-        vehicle->rect.y -= vehicle->speed;  // Move up past A1
+    LightState states[MAX_SIGNAL_LIGHTS];
+    signalStates(sim->plan, &sim->preempt, planTime, states);
+    for (int i = 0; i < 4; i++) {
+        sim->lights[i].state = states[i];
     }
+    sim->lights[0].isPriority = sim->preempt.group != 0 && !sim->preempt.releasing;
 }
 
-void moveVehicleB3toD1(Vehicle *vehicle, TrafficLight *d2Light) {
-    // Check if at intersection and if the light is red
-    bool atIntersection = (vehicle->rect.y <= SCREEN_HEIGHT / 3 + 2 * LANE_WIDTH &&
-                          vehicle->rect.x <= SCREEN_WIDTH / 3 + LANE_WIDTH);
-    
-    if (atIntersection && d2Light->state == RED) {
-        return;  // Stop at red light
+// Default plan: B2 and D2 green for 5 s, then A2 and C2 for 5 s
+void defaultSignalPlan(SignalPlan* plan) {
+    initSignalPlan(plan, 4);
+    addSignalPhase(plan, (1 << 1) | (1 << 3), 5000, 0, 0);  // B2, D2
+    addSignalPhase(plan, (1 << 0) | (1 << 2), 5000, 0, 0);  // A2, C2
+    compileSignalPlan(plan);
+}
+
+// Queue for an event or snapshot target (0-3 incoming, 4-7 middle lanes)
+VehicleQueue* simulationQueue(Simulation* sim, int target) {
+    return target < 4 ? &sim->incoming[target] : &sim->middle[target - 4];
+}
+
+// Pixels a vehicle at fixed-point (x, y) has travelled past the stop line,
+// the edge of the stop region its first leg drives into; negative before it
+int stopLineDepth(const LaneRoute* route, int x, int y) {
+    const RouteLeg* first = &route->legs[0];
+    int position = (first->axis == AXIS_X ? x : y) / FIXED_ONE;
+    if (first->axis == AXIS_X) {
+        return first->direction > 0 ? position - route->stopMinX : route->stopMaxX - position;
     }
-    
-    if (vehicle->rect.y > vehicle->targetY) {
-        vehicle->rect.y -= vehicle->speed;  // Move up
-    } else if (vehicle->rect.x > vehicle->targetX) {
-        vehicle->rect.x -= vehicle->speed;  // Move left past D1
+    return first->direction > 0 ? position - route->stopMinY : route->stopMaxY - position;
+}
+
+// A vehicle is inside the intersection once it overlaps the box and has
+// either crossed its stop line or turned onto its second leg
+bool insideIntersection(const SpatialGrid* grid, const LaneRoute* route, int x, int y) {
+    if (!gridOverlaps(grid, x / FIXED_ONE, y / FIXED_ONE, VEHICLE_SIZE, VEHICLE_SIZE)) {
+        return false;
     }
+    if (stopLineDepth(route, x, y) >= STOP_LINE_CLEARANCE) {
+        return true;
+    }
+    int dx, dy;
+    routeDirection(route, x, y, &dx, &dy);
+    return route->legs[1].direction != 0 && (route->legs[1].axis == AXIS_X ? dx : dy) != 0;
 }
 
-void moveVehicleC3toB1(Vehicle *vehicle, TrafficLight *b2Light) {
-    // Check if at intersection and if the light is red
-    bool atIntersection = (vehicle->rect.x <= SCREEN_WIDTH * 2 / 3 + vehicle->rect.w &&
-                          vehicle->rect.y >= SCREEN_HEIGHT / 3 - vehicle->rect.h);
-    
-    if (atIntersection && b2Light->state == RED) {
-        return;  // Stop at red light
+// Lanes whose vehicles may share cells with a lane's: its own, and for the
+// middle lanes the opposing one, which is drawn on the same line
+unsigned int sharedLanes(int target) {
+    unsigned int lanes = 1u << target;
+    if (target >= 4) lanes |= 1u << (target ^ 1);
+    return lanes;
+}
+
+// Whether the closed ranges [a0, a1] and [b0, b1] overlap
+bool rangesOverlap(int a0, int a1, int b0, int b1) {
+    return a0 <= b1 && b0 <= a1;
+}
+
+// Footprints, in pixels, that a vehicle at fixed-point (x, y) sweeps over
+// the rest of its route, one per remaining leg. A leg that leads into a
+// turn is taken a step past its target, where the vehicle may overshoot.
+// reachesStop reports whether the vehicle's position, which the light
+// check uses, passes through the stop region on the way. Returns the
+// number of footprints.
+int routePath(const LaneRoute* route, int x, int y, int speed, SDL_Rect path[2], bool* reachesStop) {
+    int step = (speed + FIXED_ONE - 1) / FIXED_ONE;
+    int count = 0;
+    int acrossSlack = 0;  // Spread of the turn point across the next leg
+    *reachesStop = false;
+    for (int i = 0; i < 2; i++) {
+        const RouteLeg* leg = &route->legs[i];
+        if (leg->direction == 0) break;
+        int* along = leg->axis == AXIS_X ? &x : &y;
+        int across = (leg->axis == AXIS_X ? y : x) / FIXED_ONE;
+        if (leg->direction > 0 ? *along >= toFixed(leg->target) : *along <= toFixed(leg->target)) {
+            continue;  // Leg already done
+        }
+        
+        int start = *along / FIXED_ONE;
+        bool turns = i == 0 && route->legs[1].direction != 0;
+        int end = leg->target + (turns ? leg->direction * step : 0);
+        int low = start < end ? start : end;
+        int high = start < end ? end : start;
+        int acrossLow = acrossSlack < 0 ? across + acrossSlack : across;
+        int acrossHigh = acrossSlack > 0 ? across + acrossSlack : across;
+        if (leg->axis == AXIS_X) {
+            path[count] = (SDL_Rect){low, acrossLow, high - low + VEHICLE_SIZE, acrossHigh - acrossLow + VEHICLE_SIZE};
+            *reachesStop |= rangesOverlap(low, high, route->stopMinX, route->stopMaxX) &&
+                            rangesOverlap(acrossLow, acrossHigh, route->stopMinY, route->stopMaxY);
+        } else {
+            path[count] = (SDL_Rect){acrossLow, low, acrossHigh - acrossLow + VEHICLE_SIZE, high - low + VEHICLE_SIZE};
+            *reachesStop |= rangesOverlap(acrossLow, acrossHigh, route->stopMinX, route->stopMaxX) &&
+                            rangesOverlap(low, high, route->stopMinY, route->stopMaxY);
+        }
+        count++;
+        
+        // The next leg starts somewhere between the target and the overshoot
+        *along = toFixed(leg->target);
+        acrossSlack = end - leg->target;
     }
-    
-    if (vehicle->rect.x > vehicle->targetX) {
-        vehicle->rect.x -= vehicle->speed;  // Move west
-    } else if (vehicle->rect.y < vehicle->targetY) {
-        vehicle->rect.y += vehicle->speed;  // Move south
+    return count;
+}
+
+// Whether any footprint of a path overlaps cells of a lane outside lanes
+bool pathConflict(const SpatialGrid* grid, const SDL_Rect path[], int count, unsigned int lanes) {
+    for (int k = 0; k < count; k++) {
+        if (gridConflict(grid, path[k].x, path[k].y, path[k].w, path[k].h, lanes)) return true;
     }
+    return false;
+}
+
+// Whether a vehicle at fixed-point (x, y), heading (dx, dy), overlaps the
+// intersection box now or will after its next step
+bool atIntersection(const SpatialGrid* grid, int x, int y, int dx, int dy, int speed) {
+    int step = (speed + FIXED_ONE - 1) / FIXED_ONE;
+    x /= FIXED_ONE;
+    y /= FIXED_ONE;
+    return gridOverlaps(grid, x, y, VEHICLE_SIZE, VEHICLE_SIZE) ||
+           gridOverlaps(grid, x + dx * step, y + dy * step, VEHICLE_SIZE, VEHICLE_SIZE);
 }
 
-void moveVehicleA3toC1(Vehicle *vehicle, TrafficLight *c2Light) {
-    // Check if at intersection and if the light is red
-    bool atIntersection = (vehicle->rect.y >= SCREEN_HEIGHT / 3 - vehicle->rect.h &&
-                          vehicle->rect.x >= SCREEN_WIDTH / 3 + 2 * LANE_WIDTH);
+// Gate the lanes through path reservations. A vehicle about to enter the
+// intersection reserves its whole remaining path through the box, and only
+// if that path is clear of every reservation of a crossing lane; otherwise
+// it waits. The reservation is kept until the vehicle has left the box, so
+// crossing movements take turns. A vehicle that would still stop at its
+// light (not green and its stop region ahead) does not keep a reservation,
+// and vehicles past their stop line never stop, so every reservation is
+// released in bounded time and the gating cannot deadlock.
+void updateConflicts(Simulation* sim) {
+    TRACE_ZONE("updateConflicts");
+    SDL_Rect path[2];
+    bool reachesStop;
+    clearSpatialGrid(&sim->grid);
     
-    if (atIntersection && c2Light->state == RED) {
-        return;  // Stop at red light
+    // Keep or release existing reservations and register the ones kept
+    for (int target = 0; target < 8; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        bool lightGreen = sim->lights[queue->route->light].state == GREEN;
+        for (int j = 0; j < queue->capacity; j++) {
+            queue->hold[j] = 0;
+            queue->clearing[j] = 0;
+            if (!queue->active[j]) continue;
+            
+            int count = routePath(queue->route, queue->x[j], queue->y[j], queue->speed[j], path, &reachesStop);
+            if (insideIntersection(&sim->grid, queue->route, queue->x[j], queue->y[j])) {
+                queue->clearing[j] = -1;
+                queue->reserved[j] = true;
+            } else if (queue->reserved[j]) {
+                bool inBox = false;
+                for (int k = 0; k < count; k++) {
+                    inBox |= gridOverlaps(&sim->grid, path[k].x, path[k].y, path[k].w, path[k].h);
+                }
+                queue->reserved[j] = inBox && (lightGreen || !reachesStop);
+            }
+            if (queue->reserved[j]) {
+                for (int k = 0; k < count; k++) {
+                    addToGrid(&sim->grid, path[k].x, path[k].y, path[k].w, path[k].h, target);
+                }
+            }
+        }
     }
     
-    if (vehicle->rect.y < vehicle->targetY) {
-        vehicle->rect.y += vehicle->speed;  // Move south
-    } else if (vehicle->rect.x < vehicle->targetX) {
-        vehicle->rect.x += vehicle->speed;  // Move east
+    // Vehicles at the box entrance reserve their path or wait
+    for (int target = 0; target < 8; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        bool lightGreen = sim->lights[queue->route->light].state == GREEN;
+        for (int j = 0; j < queue->capacity; j++) {
+            if (!queue->active[j] || queue->reserved[j]) continue;
+            
+            int dx, dy;
+            routeDirection(queue->route, queue->x[j], queue->y[j], &dx, &dy);
+            if (!atIntersection(&sim->grid, queue->x[j], queue->y[j], dx, dy, queue->speed[j])) {
+                continue;  // Not at the box yet
+            }
+            
+            int count = routePath(queue->route, queue->x[j], queue->y[j], queue->speed[j], path, &reachesStop);
+            if (pathConflict(&sim->grid, path, count, sharedLanes(target))) {
+                queue->hold[j] = -1;
+            } else if (lightGreen || !reachesStop) {
+                queue->reserved[j] = true;
+                for (int k = 0; k < count; k++) {
+                    addToGrid(&sim->grid, path[k].x, path[k].y, path[k].w, path[k].h, target);
+                }
+            }
+        }
     }
 }
 
-// Movement functions for middle lanes
-void moveVehicleA2toB2(Vehicle *vehicle, TrafficLight *a2Light) {
-    // Check if the light is red and vehicle is at intersection
-    bool atIntersection = (vehicle->rect.y >= SCREEN_HEIGHT / 3 - vehicle->rect.h);
-    
-    if (atIntersection && a2Light->state == RED) {
-        return;  // Stop at red light
+// Fire every event due at or before the current simulation time
+void processEvents(Simulation* sim) {
+    TRACE_ZONE("processEvents");
+    EventQueue* events = &sim->events;
+    Event event;
+    while (popDueEvent(events, sim->simTime, &event)) {
+        VehicleQueue* queue = simulationQueue(sim, event.target);
+        
+        switch (event.type) {
+            case EVENT_LANE_ENTRY:
+                // Ingested arrivals replace the synthetic ones
+                if (sim->ingest) break;
+                generateVehicle(queue, &sim->plates, &sim->rng, event.time);
+                scheduleEvent(events, event.time + queue->generationInterval, EVENT_LANE_ENTRY, event.target, 0);
+                break;
+            case EVENT_PHASE_CHANGE: {
+                // updateSignals reads the lights off the plan every step; the
+                // event only guarantees a step on every transition, also
+                // when fast-forwarding past idle stretches. Target 0 follows
+                // the plan, target 1 marks the end of a preemption interval.
+                if (event.target != 0) break;
+                Uint32 planTime = event.time + sim->signalOffset;
+                scheduleEvent(events, nextSignalChange(sim->plan, planTime) - sim->signalOffset,
+                              EVENT_PHASE_CHANGE, 0, 0);
+                break;
+            }
+            case EVENT_LANE_EXIT:
+                if (queue->active[event.slot]) {
+                    queue->active[event.slot] = 0;
+                    releasePlate(&sim->plates, queue->vehicles[event.slot].plate);
+                    queue->served++;
+                }
+                retireVehicles(queue);
+                break;
+        }
     }
-    
-    if (vehicle->rect.y < SCREEN_HEIGHT / 2) {
-        vehicle->rect.y += vehicle->speed;  // Move down
-    } else if (vehicle->rect.y < SCREEN_HEIGHT) {
-        vehicle->rect.y += vehicle->speed;  // Continue moving down
+}
+
+// Queue target for a vehicle arriving on a road lane, or -1 for lane 1,
+// which only carries vehicles leaving the intersection
+int arrivalTarget(char road, int lane) {
+    const int incomingTargets[4] = {3, 1, 2, 0};  // A3, B3, C3, D3
+    if (road < 'A' || road > 'D') return -1;
+    if (lane == 2) return 4 + (road - 'A');
+    if (lane == 3) return incomingTargets[road - 'A'];
+    return -1;
+}
+
+// Whether an arrival for the lane would enter it or its backlog, not be dropped
+bool canAcceptArrival(VehicleQueue* queue) {
+    return !isQueueFull(&queue->backlog) ||
+           (isQueueEmpty(&queue->backlog) && spawnPointClear(queue));
+}
+
+// Move a bounded number of ingested batches into the lane backlogs. An
+// arrival for a lane whose backlog is full stays in its batch, which is
+// handed back to the ingest thread's ring so the reader waits instead of
+// the vehicles being dropped.
+void drainIngest(Simulation* sim) {
+    TRACE_ZONE("drainIngest");
+    for (int b = 0; b < INGEST_BATCHES_PER_STEP; b++) {
+        IngestBatch* batch = nextIngestBatch(sim->ingest);
+        if (!batch) break;
+        for (; batch->next < batch->count; batch->next++) {
+            QueuedVehicle* arrival = &batch->vehicles[batch->next];
+            int target = arrivalTarget(arrival->road, arrival->lane);
+            if (target < 0) {
+                sim->ignoredArrivals++;
+                continue;
+            }
+            VehicleQueue* queue = simulationQueue(sim, target);
+            if (!canAcceptArrival(queue)) {
+                holdIngestBatch(sim->ingest, batch);
+                return;
+            }
+            arriveVehicle(queue, &sim->plates, *arrival);
+        }
+        releaseIngestBatch(sim->ingest, batch);
+    }
+}
+
+// Number of vehicles that fit bumper to bumper along a lane route
+int routeCapacity(const LaneRoute* route) {
+    int x = route->spawnX;
+    int y = route->spawnY;
+    int length = 0;
+    for (int i = 0; i < 2; i++) {
+        const RouteLeg* leg = &route->legs[i];
+        if (leg->direction == 0) continue;
+        int* coord = leg->axis == AXIS_X ? &x : &y;
+        length += abs(leg->target - *coord);
+        *coord = leg->target;
+    }
+    return length / VEHICLE_SIZE + 1;
+}
+
+// Set up lights, lane routes and queues, and schedule the first events.
+// A laneCapacity of 0 sizes every lane to the vehicles its route can hold.
+void initSimulation(Simulation* sim, uint64_t seed, int laneCapacity, int backlogCapacity,
+                    const Uint32 generationIntervals[8], const SignalPlan* plan) {
+    // Initialize traffic lights for middle lanes (A2, B2, C2, D2); their
+    // states come from the signal plan
+    sim->lights[0] = initTrafficLight(SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5, SCREEN_HEIGHT / 4, 15);    // A2 light
+    sim->lights[1] = initTrafficLight(SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5, SCREEN_HEIGHT * 3 / 4, 15); // B2 light
+    sim->lights[2] = initTrafficLight(SCREEN_WIDTH * 3 / 4, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5, 15); // C2 light
+    sim->lights[3] = initTrafficLight(SCREEN_WIDTH / 4, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5, 15);  // D2 light
+    sim->plan = plan;
+    sim->signalOffset = plan->offset;
+    memset(&sim->preempt, 0, sizeof(sim->preempt));
+
+    // Movement routes for every lane
+    initLaneRoutes(sim->routes);
+
+    // Lane capacities scale with the route length unless fixed by the caller
+    int capacities[8];
+    for (int i = 0; i < 8; i++) {
+        capacities[i] = laneCapacity > 0 ? laneCapacity : routeCapacity(&sim->routes[i]);
+    }
+
+    // Initialize vehicle queues for each incoming lane
+    const Uint32* intervals = generationIntervals;
+    sim->incoming[0] = initVehicleQueue(capacities[0], backlogCapacity, intervals[0], 'D', 3, &sim->routes[0]);  // D3 to A1 vehicles
+    sim->incoming[1] = initVehicleQueue(capacities[1], backlogCapacity, intervals[1], 'B', 3, &sim->routes[1]);  // B3 to D1 vehicles
+    sim->incoming[2] = initVehicleQueue(capacities[2], backlogCapacity, intervals[2], 'C', 3, &sim->routes[2]);  // C3 to B1 vehicles
+    sim->incoming[3] = initVehicleQueue(capacities[3], backlogCapacity, intervals[3], 'A', 3, &sim->routes[3]);  // A3 to C1 vehicles
+
+    // Initialize vehicle queues for middle lanes
+    sim->middle[0] = initVehicleQueue(capacities[4], backlogCapacity, intervals[4], 'A', 2, &sim->routes[4]);  // A2 to B2 vehicles
+    sim->middle[1] = initVehicleQueue(capacities[5], backlogCapacity, intervals[5], 'B', 2, &sim->routes[5]);  // B2 to A2 vehicles
+    sim->middle[2] = initVehicleQueue(capacities[6], backlogCapacity, intervals[6], 'C', 2, &sim->routes[6]);  // C2 to D2 vehicles
+    sim->middle[3] = initVehicleQueue(capacities[7], backlogCapacity, intervals[7], 'D', 2, &sim->routes[7]);  // D2 to C2 vehicles
+
+    // Room for a plate per visible vehicle; the table grows if needed
+    int totalCapacity = 0;
+    for (int i = 0; i < 8; i++) {
+        totalCapacity += capacities[i];
+    }
+    initPlateTable(&sim->plates, totalCapacity);
+    initSpatialGrid(&sim->grid, SCREEN_WIDTH / 3, SCREEN_HEIGHT / 3,
+                    LANE_WIDTH * 3, LANE_WIDTH * 3, CONFLICT_CELL_SIZE);
+
+    // Schedule the first vehicle of every lane and the first toggle of every light
+    seedRng(&sim->rng, seed);
+    sim->simTime = 0;
+    sim->ingest = NULL;
+    sim->ignoredArrivals = 0;
+    initEventQueue(&sim->events, 64);
+    for (int i = 0; i < 4; i++) {
+        scheduleEvent(&sim->events, sim->incoming[i].generationInterval, EVENT_LANE_ENTRY, i, 0);
+        scheduleEvent(&sim->events, sim->middle[i].generationInterval, EVENT_LANE_ENTRY, 4 + i, 0);
+    }
+    scheduleEvent(&sim->events, nextSignalChange(plan, sim->signalOffset) - sim->signalOffset,
+                  EVENT_PHASE_CHANGE, 0, 0);
+    updateSignals(sim);
+}
+
+// Free everything owned by the simulation
+void freeSimulation(Simulation* sim) {
+    freeEventQueue(&sim->events);
+    freePlateTable(&sim->plates);
+    freeSpatialGrid(&sim->grid);
+    for (int i = 0; i < 4; i++) {
+        freeVehicleQueue(&sim->incoming[i]);
+        freeVehicleQueue(&sim->middle[i]);
     }
 }
 
-void moveVehicleB2toA2(Vehicle *vehicle, TrafficLight *b2Light) {
-    // Check if the light is red and vehicle is at intersection
-    bool atIntersection = (vehicle->rect.y <= SCREEN_HEIGHT * 2 / 3);
+// Little-endian helpers for the snapshot format
+void writeU32(FILE* file, uint32_t value) {
+    unsigned char bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+uint32_t readU32(FILE* file) {
+    unsigned char bytes[4] = {0, 0, 0, 0};
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) return 0;
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+void writeU16(FILE* file, uint16_t value) {
+    unsigned char bytes[2] = {value, value >> 8};
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+uint16_t readU16(FILE* file) {
+    unsigned char bytes[2] = {0, 0};
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) return 0;
+    return bytes[0] | (bytes[1] << 8);
+}
+
+// Save the full simulation state (queues, lights, pending events and the
+// random stream) to a compact binary file. Only occupied queue slots are
+// written; lane routes and light positions are rebuilt by initSimulation.
+bool saveSnapshot(Simulation* sim, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("Could not write snapshot %s\n", path);
+        return false;
+    }
+    
+    fwrite("TSIM", 1, 4, file);
+    writeU32(file, SNAPSHOT_VERSION);
+    writeU32(file, sim->simTime);
+    writeU32(file, (uint32_t)sim->rng.state);
+    writeU32(file, (uint32_t)(sim->rng.state >> 32));
     
-    if (atIntersection && b2Light->state == RED) {
-        return;  // Stop at red light
+    for (int i = 0; i < 4; i++) {
+        TrafficLight* light = &sim->lights[i];
+        fputc(light->state, file);
+        fputc(light->isPriority, file);
     }
+    SignalPreempt* preempt = &sim->preempt;
+    fputc(preempt->group, file);
+    fputc(preempt->releasing, file);
+    fputc(preempt->giving, file);
+    fputc(preempt->keep, file);
+    writeU32(file, preempt->amberEnd);
+    writeU32(file, preempt->clearEnd);
+    writeU32(file, preempt->amber);
+    writeU32(file, preempt->allRed);
     
-    if (vehicle->rect.y > SCREEN_HEIGHT / 2) {
-        vehicle->rect.y -= vehicle->speed;  // Move up
-    } else if (vehicle->rect.y > 0) {
-        vehicle->rect.y -= vehicle->speed;  // Continue moving up
+    // Queue contents in ring order, so they can be restored starting at slot 0
+    for (int target = 0; target < 8; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        writeU32(file, queue->capacity);
+        writeU32(file, queue->size);
+        writeU32(file, queue->lastGenerationTime);
+        writeU32(file, queue->generationInterval);
+        writeU32(file, queue->served);
+        writeU32(file, queue->deferred);
+        writeU32(file, queue->dropped);
+        
+        writeU32(file, queue->backlog.capacity);
+        writeU32(file, queue->backlog.size);
+        for (int k = 0; k < queue->backlog.size; k++) {
+            QueuedVehicle* waiting = &queue->backlog.vehicles[(queue->backlog.front + k) % queue->backlog.capacity];
+            fputc(waiting->priority != 0, file);
+            fwrite(waiting->number, 1, PLATE_LENGTH, file);
+        }
+        
+        for (int k = 0; k < queue->size; k++) {
+            int slot = (queue->front + k) % queue->capacity;
+            Vehicle* vehicle = &queue->vehicles[slot];
+            char number[PLATE_LENGTH + 1] = "";
+            if (queue->active[slot]) {
+                strncpy(number, plateString(&sim->plates, vehicle->plate), PLATE_LENGTH);
+            }
+            fputc(vehicle->isPriority, file);
+            fwrite(number, 1, PLATE_LENGTH, file);
+            writeU16(file, (uint16_t)queue->x[slot]);
+            writeU16(file, (uint16_t)queue->y[slot]);
+            fputc(queue->speed[slot], file);
+            fputc(queue->active[slot] != 0, file);
+            fputc(queue->reserved[slot], file);
+        }
     }
+    
+    // Pending events; lane exits store their slot relative to the queue front
+    writeU32(file, sim->events.size);
+    writeU32(file, sim->events.nextSeq);
+    for (int i = 0; i < sim->events.size; i++) {
+        Event* event = &sim->events.events[i];
+        int slot = 0;
+        if (event->type == EVENT_LANE_EXIT) {
+            VehicleQueue* queue = simulationQueue(sim, event->target);
+            slot = (event->slot - queue->front + queue->capacity) % queue->capacity;
+        }
+        writeU32(file, event->time);
+        writeU32(file, event->seq);
+        fputc(event->type, file);
+        fputc(event->target, file);
+        writeU32(file, slot);
+    }
+    
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) ok = false;
+    if (!ok) {
+        printf("Failed writing snapshot %s\n", path);
+    }
+    return ok;
 }
 
-void moveVehicleC2toD2(Vehicle *vehicle, TrafficLight *c2Light) {
-    // Check if the light is red and vehicle is at intersection
-    bool atIntersection = (vehicle->rect.x <= SCREEN_WIDTH * 2 / 3);
+// Restore state written by saveSnapshot into an initialized simulation
+bool loadSnapshot(Simulation* sim, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Could not open snapshot %s\n", path);
+        return false;
+    }
+    
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "TSIM", 4) != 0 ||
+        readU32(file) != SNAPSHOT_VERSION) {
+        printf("%s is not a compatible snapshot\n", path);
+        fclose(file);
+        return false;
+    }
+    
+    sim->simTime = readU32(file);
+    uint64_t rngLow = readU32(file);
+    sim->rng.state = rngLow | ((uint64_t)readU32(file) << 32);
+    
+    for (int i = 0; i < 4; i++) {
+        TrafficLight* light = &sim->lights[i];
+        int state = fgetc(file);
+        light->state = state == GREEN || state == AMBER ? (LightState)state : RED;
+        light->isPriority = fgetc(file) == 1;
+    }
+    SignalPreempt* preempt = &sim->preempt;
+    preempt->group = fgetc(file) & 0xFF;
+    preempt->releasing = fgetc(file) == 1;
+    preempt->giving = fgetc(file) & 0xFF;
+    preempt->keep = fgetc(file) & 0xFF;
+    preempt->amberEnd = readU32(file);
+    preempt->clearEnd = readU32(file);
+    preempt->amber = readU32(file);
+    preempt->allRed = readU32(file);
+    
+    bool ok = true;
+    for (int target = 0; target < 8 && ok; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        int capacity = (int)readU32(file);
+        int size = (int)readU32(file);
+        Uint32 lastGenerationTime = readU32(file);
+        Uint32 generationInterval = readU32(file);
+        unsigned int served = readU32(file);
+        unsigned int deferred = readU32(file);
+        unsigned int dropped = readU32(file);
+        int backlogCapacity = (int)readU32(file);
+        int backlogSize = (int)readU32(file);
+        if (capacity <= 0 || capacity > 1 << 20 || size < 0 || size > capacity ||
+            backlogCapacity <= 0 || backlogCapacity > 1 << 20 || backlogSize < 0 || backlogSize > backlogCapacity) {
+            ok = false;
+            break;
+        }
+        
+        // Start from an empty queue of the saved capacities
+        VehicleQueue restored = initVehicleQueue(capacity, backlogCapacity, generationInterval,
+                                                 queue->road, queue->lane, queue->route);
+        freeVehicleQueue(queue);
+        *queue = restored;
+        queue->lastGenerationTime = lastGenerationTime;
+        queue->served = served;
+        queue->deferred = deferred;
+        queue->dropped = dropped;
+        
+        for (int k = 0; k < backlogSize; k++) {
+            QueuedVehicle waiting = {"", queue->road, queue->lane, fgetc(file) == 1, '\0', 0};
+            if (fread(waiting.number, 1, PLATE_LENGTH, file) != PLATE_LENGTH) ok = false;
+            enqueue(&queue->backlog, waiting);
+        }
+        
+        for (int slot = 0; slot < size; slot++) {
+            Vehicle* vehicle = &queue->vehicles[slot];
+            char number[PLATE_LENGTH + 1] = "";
+            vehicle->isPriority = fgetc(file) == 1;
+            if (fread(number, 1, PLATE_LENGTH, file) != PLATE_LENGTH) ok = false;
+            queue->x[slot] = queue->prevX[slot] = (int16_t)readU16(file);
+            queue->y[slot] = queue->prevY[slot] = (int16_t)readU16(file);
+            queue->speed[slot] = (uint8_t)fgetc(file);
+            queue->active[slot] = fgetc(file) == 1 ? -1 : 0;
+            queue->reserved[slot] = fgetc(file) == 1;
+            vehicle->plate = queue->active[slot] ? internPlate(&sim->plates, number) : PLATE_NONE;
+        }
+        queue->size = size;
+        queue->front = 0;
+        queue->rear = size - 1;
+    }
     
-    if (atIntersection && c2Light->state == RED) {
-        return;  // Stop at red light
+    // Replace the scheduled events with the saved ones
+    int eventCount = ok ? (int)readU32(file) : -1;
+    if (eventCount < 0 || eventCount > 1 << 20) {
+        ok = false;
+    } else {
+        freeEventQueue(&sim->events);
+        initEventQueue(&sim->events, eventCount > 64 ? eventCount : 64);
+        sim->events.nextSeq = readU32(file);
+        for (int i = 0; i < eventCount; i++) {
+            Event event;
+            event.time = readU32(file);
+            event.seq = readU32(file);
+            event.type = (EventType)fgetc(file);
+            event.target = fgetc(file);
+            event.slot = (int)readU32(file);
+            if (event.type > EVENT_LANE_EXIT || event.target < 0 || event.target >= 8 ||
+                event.slot < 0 || event.slot >= simulationQueue(sim, event.target)->capacity) {
+                ok = false;
+                break;
+            }
+            restoreEvent(&sim->events, event);
+        }
     }
     
-    if (vehicle->rect.x > SCREEN_WIDTH / 2) {
-        vehicle->rect.x -= vehicle->speed;  // Move left
-    } else if (vehicle->rect.x > 0) {
-        vehicle->rect.x -= vehicle->speed;  // Continue moving left
+    if (ferror(file) || feof(file)) ok = false;
+    fclose(file);
+    if (!ok) {
+        printf("Snapshot %s is truncated or corrupt\n", path);
+    }
+    return ok;
+}
+
+// Print how many vehicles every lane served, deferred and dropped
+void printLaneCounters(Simulation* sim) {
+    printf("Lane  Served  Deferred  Dropped  Waiting\n");
+    for (int target = 0; target < 8; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        printf("%c%d    %6u  %8u  %7u  %7d\n", queue->road, queue->lane,
+               queue->served, queue->deferred, queue->dropped, queue->backlog.size);
     }
 }
 
-void moveVehicleD2toC2(Vehicle *vehicle, TrafficLight *d2Light) {
-    // Check if the light is red and vehicle is at intersection
-    bool atIntersection = (vehicle->rect.x >= SCREEN_WIDTH / 3);
+// Advance the simulation by one fixed step. Returns the number of vehicles that moved.
+int stepSimulation(Simulation* sim) {
+    TRACE_ZONE("stepSimulation");
+    // Remember where every vehicle was so rendering can interpolate
+    for (int i = 0; i < 4; i++) {
+        VehicleQueue* lanes[2] = {&sim->incoming[i], &sim->middle[i]};
+        for (int k = 0; k < 2; k++) {
+            memcpy(lanes[k]->prevX, lanes[k]->x, lanes[k]->capacity * sizeof(int16_t));
+            memcpy(lanes[k]->prevY, lanes[k]->y, lanes[k]->capacity * sizeof(int16_t));
+        }
+    }
+    
+    // Spawn vehicles, switch lights and retire exited vehicles, then let
+    // backlogged arrivals into lanes that have room again
+    processEvents(sim);
+    if (sim->ingest) {
+        drainIngest(sim);
+    }
+    for (int i = 0; i < 4; i++) {
+        admitBacklog(&sim->incoming[i], &sim->plates);
+        admitBacklog(&sim->middle[i], &sim->plates);
+    }
+    
+    // Follow the signal plan, with A2 priority layered on top
+    updateSignals(sim);
     
-    if (atIntersection && d2Light->state == RED) {
-        return;  // Stop at red light
+    // Hold vehicles whose path into the intersection is taken by another lane
+    updateConflicts(sim);
+    
+    int movedVehicles = 0;
+    
+    // Move every lane in bulk through the movement kernel
+    {
+        TRACE_ZONE("moveLanes");
+        for (int i = 0; i < 4; i++) {
+            movedVehicles += moveQueueVehicles(&sim->incoming[i], i, sim->lights, &sim->events, sim->simTime);
+            movedVehicles += moveQueueVehicles(&sim->middle[i], 4 + i, sim->lights, &sim->events, sim->simTime);
+        }
     }
     
-    if (vehicle->rect.x < SCREEN_WIDTH / 2) {
-        vehicle->rect.x += vehicle->speed;  // Move right
-    } else if (vehicle->rect.x < SCREEN_WIDTH) {
-        vehicle->rect.x += vehicle->speed;  // Continue moving right
+    // Dequeue vehicles from A2 if it has priority and light is green
+    if (sim->lights[0].isPriority && sim->lights[0].state == GREEN) {
+        // Find the frontmost vehicle in A2 queue
+        VehicleQueue* a2Queue = &sim->middle[0];
+        int frontVehicleIndex = -1;
+        int minY = toFixed(SCREEN_HEIGHT);
+        
+        for (int j = 0; j < a2Queue->capacity; j++) {
+            if (a2Queue->active[j] && 
+                a2Queue->y[j] < minY &&
+                a2Queue->y[j] >= toFixed(SCREEN_HEIGHT / 3)) {
+                minY = a2Queue->y[j];
+                frontVehicleIndex = j;
+            }
+        }
+        
+        // Move the frontmost vehicle
+        if (frontVehicleIndex != -1) {
+            a2Queue->speed[frontVehicleIndex] = 6 * FIXED_ONE;  // Slightly faster when dequeuing
+        }
     }
+    
+    sim->simTime += SIM_STEP_MS;
+    return movedVehicles;
 }
 
-// Check if vehicle has reached destination
-bool hasReachedDestination(Vehicle* vehicle) {
-    switch (vehicle->road) {
-        case 'A':
-            if (vehicle->lane == 2) {
-                return vehicle->rect.y >= SCREEN_HEIGHT;
-            } else if (vehicle->lane == 3) {
-                return vehicle->rect.x >= SCREEN_WIDTH;
+// Fast-forward over the coming steps while all they would do is move
+// vehicles straight along their routes: no event falls due, nothing waits
+// in a backlog, and no vehicle reaches the intersection, its exit, or a
+// stop region whose light is not green. Leaves the simulation exactly as
+// that many stepSimulation calls would; returns how many were skipped, at
+// most maxSteps.
+int skipQuietSteps(Simulation* sim, int maxSteps) {
+    TRACE_ZONE("skipQuietSteps");
+    if (sim->ingest || sim->lights[0].isPriority) return 0;
+    int limit = maxSteps;
+    if (!isEventQueueEmpty(&sim->events)) {
+        int untilEvent = (int)(nextEventTime(&sim->events) - sim->simTime);
+        int eventSteps = untilEvent > 0 ? (untilEvent + (int)SIM_STEP_MS - 1) / (int)SIM_STEP_MS : 0;
+        if (eventSteps < limit) limit = eventSteps;
+    }
+    
+    // Shorten the skip to the first step in which any vehicle stops moving
+    // straight, or is about to be gated, held or retired
+    for (int target = 0; target < 8 && limit > 0; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        if (!isQueueEmpty(&queue->backlog)) return 0;
+        bool lightGreen = sim->lights[queue->route->light].state == GREEN;
+        for (int j = 0; j < queue->capacity && limit > 0; j++) {
+            if (!queue->active[j]) continue;
+            if (queue->reserved[j] || queue->hold[j] || queue->clearing[j]) return 0;
+            int x = queue->x[j];
+            int y = queue->y[j];
+            if (!lightGreen && inStopRegion(queue->route, x, y)) continue;  // Waits for the light
+            
+            int dx, dy;
+            routeDirection(queue->route, x, y, &dx, &dy);
+            int steps = 0;
+            while (steps < limit) {
+                int stepDx, stepDy;
+                routeDirection(queue->route, x, y, &stepDx, &stepDy);
+                if (stepDx != dx || stepDy != dy ||
+                    atIntersection(&sim->grid, x, y, dx, dy, queue->speed[j]) ||
+                    (!lightGreen && inStopRegion(queue->route, x, y))) {
+                    break;
+                }
+                x += dx * queue->speed[j];
+                y += dy * queue->speed[j];
+                if (routeExited(queue->route, x, y)) break;
+                steps++;
             }
-            break;
-        case 'B':
-            if (vehicle->lane == 2) {
-                return vehicle->rect.y <= 0;
-            } else if (vehicle->lane == 3) {
-                return vehicle->rect.x <= 0;
+            limit = steps;
+        }
+    }
+    if (limit <= 0) return 0;
+    
+    for (int target = 0; target < 8; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        bool lightGreen = sim->lights[queue->route->light].state == GREEN;
+        for (int j = 0; j < queue->capacity; j++) {
+            int dx = 0, dy = 0;
+            if (queue->active[j] && (lightGreen || !inStopRegion(queue->route, queue->x[j], queue->y[j]))) {
+                routeDirection(queue->route, queue->x[j], queue->y[j], &dx, &dy);
             }
-            break;
-        case 'C':
-            if (vehicle->lane == 2) {
-                return vehicle->rect.x <= 0;
-            } else if (vehicle->lane == 3) {
-                return vehicle->rect.y >= SCREEN_HEIGHT;
+            queue->prevX[j] = queue->x[j] + dx * queue->speed[j] * (limit - 1);
+            queue->prevY[j] = queue->y[j] + dy * queue->speed[j] * (limit - 1);
+            queue->x[j] += dx * queue->speed[j] * limit;
+            queue->y[j] += dy * queue->speed[j] * limit;
+        }
+    }
+    sim->simTime += limit * SIM_STEP_MS;
+    return limit;
+}
+
+// Scale the renderer so that zoom is applied around the screen centre
+void applyZoom(SDL_Renderer *renderer, float zoom) {
+    SDL_RenderSetScale(renderer, zoom, zoom);
+    // The viewport is in scaled units; offset it so the centre stays put
+    SDL_Rect viewport = {(int)(SCREEN_WIDTH / 2 * (1 - zoom) / zoom),
+                         (int)(SCREEN_HEIGHT / 2 * (1 - zoom) / zoom),
+                         SCREEN_WIDTH, SCREEN_HEIGHT};
+    SDL_RenderSetViewport(renderer, &viewport);
+}
+
+// Number of vehicles currently held by the lanes
+int countVehicles(Simulation* sim) {
+    int count = 0;
+    for (int i = 0; i < 4; i++) {
+        count += sim->incoming[i].size + sim->middle[i].size;
+    }
+    return count;
+}
+
+// Draw vehicles one by one, batched into a single call per colour and
+// skipping those outside the zoomed-in area
+void drawVehicles(SDL_Renderer *renderer, Simulation* sim, RenderView* view, float alpha) {
+    int halfWidth = SCREEN_WIDTH / 2 / view->zoom + VEHICLE_SIZE;
+    int halfHeight = SCREEN_HEIGHT / 2 / view->zoom + VEHICLE_SIZE;
+    
+    for (int pass = 0; pass < 2; pass++) {
+        bool priority = pass == 1;
+        int count = 0;
+        for (int target = 0; target < 8; target++) {
+            VehicleQueue* queue = simulationQueue(sim, target);
+            for (int j = 0; j < queue->capacity; j++) {
+                if (!queue->active[j] || queue->vehicles[j].isPriority != priority) continue;
+                SDL_Rect rect = vehicleRect(queue, j, alpha);
+                if (abs(rect.x - SCREEN_WIDTH / 2) > halfWidth || abs(rect.y - SCREEN_HEIGHT / 2) > halfHeight) continue;
+                
+                if (count == view->rectCapacity) {
+                    int newCapacity = view->rectCapacity ? view->rectCapacity * 2 : 256;
+                    SDL_Rect* grown = (SDL_Rect*)realloc(view->rects, newCapacity * sizeof(SDL_Rect));
+                    if (!grown) break;
+                    view->rects = grown;
+                    view->rectCapacity = newCapacity;
+                }
+                view->rects[count++] = rect;
             }
-            break;
-        case 'D':
-            if (vehicle->lane == 2) {
-                return vehicle->rect.x >= SCREEN_WIDTH;
-            } else if (vehicle->lane == 3) {
-                return vehicle->rect.y <= 0;
+        }
+        
+        if (priority) {
+            SDL_SetRenderDrawColor(renderer, 255, 165, 0, 255);  // Orange for priority vehicles
+        } else {
+            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);  // Red color for the vehicle
+        }
+        SDL_RenderFillRects(renderer, view->rects, count);
+    }
+}
+
+// Aggregate lane occupancy into the heatmap and draw it
+void drawDensity(SDL_Renderer *renderer, Simulation* sim, RenderView* view) {
+    clearDensityMap(&view->density);
+    for (int target = 0; target < 8; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        for (int j = 0; j < queue->capacity; j++) {
+            if (queue->active[j]) {
+                addDensity(&view->density, queue->x[j] / FIXED_ONE + VEHICLE_SIZE / 2,
+                           queue->y[j] / FIXED_ONE + VEHICLE_SIZE / 2);
             }
-            break;
+        }
     }
-    return false;
+    renderDensityMap(&view->density, renderer);
 }
 
-// Update priority status for A2 lane and set traffic lights accordingly
-void updatePriorityStatus(VehicleQueue* a2Queue, TrafficLight* trafficLights) {
-    // Check if A2 has more than 5 vehicles
-    if (a2Queue->size > 5) {
-        // Set A2 to green and all others to red
-        trafficLights[0].state = GREEN;  // A2
-        trafficLights[0].isPriority = true;
-        trafficLights[1].state = RED;    // B2
-        trafficLights[2].state = RED;    // C2
-        trafficLights[3].state = RED;    // D2
+// Draw roads, lights, lane names and vehicles. alpha is the fraction of a
+// simulation step elapsed since the last one, used to interpolate vehicles.
+void renderFrame(SDL_Renderer *renderer, TTF_Font *font, Simulation* sim, RenderView* view, float alpha) {
+    TRACE_ZONE("renderFrame");
+    // Clear the renderer
+    applyZoom(renderer, 1.0f);
+    SDL_SetRenderDrawColor(renderer, 0, 150, 0, 255);  // Green background
+    SDL_RenderClear(renderer);
+    applyZoom(renderer, view->zoom);
+    
+    // Draw roads, traffic lights, and lane names
+    drawCrossroad(renderer);
+    drawTrafficLights(renderer, sim->lights, 4);
+    
+    // Draw text for lane names (A1, A2, etc.)
+    SDL_Color laneColor = {255, 255, 255, 255};  // White text color
+    
+    // Draw lane names
+    renderText(renderer, font, "A1", SCREEN_WIDTH / 3 + LANE_WIDTH / 4 - 15, SCREEN_HEIGHT / 6, laneColor);
+    renderText(renderer, font, "A2", SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 15, SCREEN_HEIGHT / 6, laneColor);
+    renderText(renderer, font, "A3", SCREEN_WIDTH / 3 + LANE_WIDTH * 2.5 - 15, SCREEN_HEIGHT / 6, laneColor);
+    
+    renderText(renderer, font, "B1", SCREEN_WIDTH / 3 + LANE_WIDTH / 4 - 15, SCREEN_HEIGHT * 5 / 6, laneColor);
+    renderText(renderer, font, "B2", SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 15, SCREEN_HEIGHT * 5 / 6, laneColor);
+    renderText(renderer, font, "B3", SCREEN_WIDTH / 3 + LANE_WIDTH * 2.5 - 15, SCREEN_HEIGHT * 5 / 6, laneColor);
+    
+    renderText(renderer, font, "C1", SCREEN_WIDTH * 5 / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH / 4 - 15, laneColor);
+    renderText(renderer, font, "C2", SCREEN_WIDTH * 5 / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 15, laneColor);
+    renderText(renderer, font, "C3", SCREEN_WIDTH * 5 / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 2.5 - 15, laneColor);
+    
+    renderText(renderer, font, "D1", SCREEN_WIDTH / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH / 4 - 15, laneColor);
+    renderText(renderer, font, "D2", SCREEN_WIDTH / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 15, laneColor);
+    renderText(renderer, font, "D3", SCREEN_WIDTH / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 2.5 - 15, laneColor);
+    
+    // Draw all vehicles from incoming and middle lanes, or their density
+    // when there are too many to tell apart at this zoom level
+    if (view->hasDensity && view->zoom < LOD_ZOOM && countVehicles(sim) > view->lodThreshold) {
+        drawDensity(renderer, sim, view);
     } else {
-        // Reset priority flag
-        trafficLights[0].isPriority = false;
+        drawVehicles(renderer, sim, view, alpha);
+    }
+}
+
+// Fold one frame's timings into the smoothed counters and show them in the
+// window title twice a second
+void updateFrameStats(FrameStats* stats, SDL_Window* window, double frameMs, double stepMs, int steps) {
+    stats->frameMs = stats->frameMs * 0.9 + frameMs * 0.1;
+    if (steps > 0) {
+        stats->stepMs = stats->stepMs * 0.9 + (stepMs / steps) * 0.1;
+    }
+    stats->stepsPerFrame = steps;
+    
+    Uint32 now = SDL_GetTicks();
+    if (now - stats->lastReportTime >= 500) {
+        char title[128];
+        snprintf(title, sizeof(title), "Traffic Simulation - %.0f FPS | frame %.2f ms | step %.3f ms",
+                 stats->frameMs > 0 ? 1000.0 / stats->frameMs : 0.0, stats->frameMs, stats->stepMs);
+        SDL_SetWindowTitle(window, title);
+        stats->lastReportTime = now;
     }
 }
 
+// Gather the per-lane and light state published to telemetry subscribers
+void collectTelemetry(Simulation* sim, FrameStats* stats, unsigned int frame, TelemetryStats* sample) {
+    sample->simTime = sim->simTime;
+    sample->frame = frame;
+    sample->frameMs = stats->frameMs;
+    sample->stepMs = stats->stepMs;
+    for (int target = 0; target < TELEMETRY_LANES; target++) {
+        VehicleQueue* queue = simulationQueue(sim, target);
+        LaneTelemetry* lane = &sample->lanes[target];
+        lane->road = queue->road;
+        lane->lane = queue->lane;
+        lane->size = queue->size;
+        lane->backlog = queue->backlog.size;
+        lane->served = queue->served;
+        lane->dropped = queue->dropped;
+    }
+    for (int i = 0; i < TELEMETRY_LIGHTS; i++) {
+        LightState state = sim->lights[i].state;
+        sample->lights[i] = state == GREEN ? "green" : state == AMBER ? "amber" : "red";
+    }
+}
+
+// Milliseconds elapsed since a performance counter reading
+double elapsedMs(Uint64 since) {
+    return (SDL_GetPerformanceCounter() - since) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
 int main(int argc, char *argv[]) {
-    (void)argc; (void)argv;  // Prevent unused parameter warnings
+    // --fast runs the simulation as quickly as possible, jumping over steps
+    // in which vehicles only move straight along their routes.
+    // --load-snapshot starts from a saved state; --save-snapshot writes the
+    // state on exit and whenever S is pressed.
+    // --headless renders into an offscreen target without showing a window;
+    // --capture records every frame to a PPM directory or "|encoder command";
+    // --duration stops after that many simulated seconds.
+    // --ingest [DIR] takes arrivals from the generator's lane files in DIR
+    // (default: current directory) instead of spawning them.
+    // --telemetry PATH streams stats as JSON lines on a UNIX domain socket.
+    // --signal-plan FILE replaces the default light timing with a phase table.
+    // --spawn-interval LANE MS sets the time between generated arrivals for
+    // one lane (e.g. A2), or for every lane with "all".
+    bool fastForward = false;
+    bool headless = false;
+    const char* captureTarget = NULL;
+    int captureBuffers = DEFAULT_CAPTURE_BUFFERS;
+    unsigned int durationMs = 0;  // 0 = run until the window is closed
+    const char* ingestDirectory = NULL;
+    const char* telemetryPath = NULL;
+    const char* signalPlanPath = NULL;
+    int telemetryIntervalMs = DEFAULT_TELEMETRY_INTERVAL_MS;
+    const char* loadSnapshotPath = NULL;
+    const char* saveSnapshotPath = NULL;
+    uint64_t seed = time(NULL);
+    int laneCapacity = 0;  // 0 = size lanes to their routes
+    int lodThreshold = DEFAULT_LOD_THRESHOLD;
+    int backlogCapacity = MAX_QUEUE_SIZE;
+    Uint32 generationIntervals[8];
+    memcpy(generationIntervals, DEFAULT_GENERATION_INTERVALS, sizeof(generationIntervals));
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fast") == 0) {
+            fastForward = true;
+        } else if (strcmp(argv[i], "--load-snapshot") == 0 && i + 1 < argc) {
+            loadSnapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc) {
+            saveSnapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--lane-capacity") == 0 && i + 1 < argc) {
+            laneCapacity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--backlog") == 0 && i + 1 < argc) {
+            backlogCapacity = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lod-threshold") == 0 && i + 1 < argc) {
+            lodThreshold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            captureTarget = argv[++i];
+        } else if (strcmp(argv[i], "--capture-buffers") == 0 && i + 1 < argc) {
+            captureBuffers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ingest") == 0) {
+            ingestDirectory = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : ".";
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryPath = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry-interval") == 0 && i + 1 < argc) {
+            telemetryIntervalMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--signal-plan") == 0 && i + 1 < argc) {
+            signalPlanPath = argv[++i];
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            durationMs = (unsigned int)(atof(argv[++i]) * 1000);
+        } else if (strcmp(argv[i], "--spawn-interval") == 0 && i + 2 < argc) {
+            const char* lane = argv[++i];
+            int interval = atoi(argv[++i]);
+            if (interval < 1) interval = 1;
+            if (strcmp(lane, "all") == 0) {
+                for (int target = 0; target < 8; target++) {
+                    generationIntervals[target] = interval;
+                }
+            } else {
+                int target = strlen(lane) == 2 ? arrivalTarget(lane[0], lane[1] - '0') : -1;
+                if (target < 0) {
+                    printf("Unknown lane %s for --spawn-interval\n", lane);
+                    return 1;
+                }
+                generationIntervals[target] = interval;
+            }
+        }
+    }
 
-    // Seed random number generator
-    srand(time(NULL));
+    // Headless servers have no display; use the dummy video driver unless
+    // the environment picks one
+    if (headless && !getenv("SDL_VIDEODRIVER")) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
 
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
@@ -533,19 +1481,47 @@ int main(int argc, char *argv[]) {
 
     SDL_Window *window = SDL_CreateWindow("Traffic Simulation",
                                           SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-                                          SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+                                          SCREEN_WIDTH, SCREEN_HEIGHT,
+                                          headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN);
     if (!window) {
         printf("Window creation failed! SDL_Error: %s\n", SDL_GetError());
         SDL_Quit();
         return 1;
     }
 
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    // Present with vsync when the driver supports it; otherwise the main
+    // loop paces frames itself. Headless runs never present, so they draw
+    // into a target texture on whichever renderer is available.
+    SDL_Renderer *renderer = NULL;
+    if (headless) {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_TARGETTEXTURE);
+    } else {
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        if (!renderer) {
+            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+        }
+    }
     if (!renderer) {
         SDL_DestroyWindow(window);
         SDL_Quit();
         return 1;
     }
+    SDL_RendererInfo rendererInfo;
+    bool vsync = !headless && SDL_GetRendererInfo(renderer, &rendererInfo) == 0 &&
+                 (rendererInfo.flags & SDL_RENDERER_PRESENTVSYNC);
+
+    SDL_Texture *renderTarget = NULL;
+    if (headless) {
+        renderTarget = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                         SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (!renderTarget || SDL_SetRenderTarget(renderer, renderTarget) != 0) {
+            printf("Offscreen render target unavailable! SDL_Error: %s\n", SDL_GetError());
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            SDL_Quit();
+            return 1;
+        }
+    }
 
     // Load font for lane names
     TTF_Font *font = TTF_OpenFont("arial.ttf", 24);  // Make sure you have this font
@@ -555,217 +1531,217 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Initialize traffic lights for middle lanes (A2, B2, C2, D2)
-    // With different initial states and toggle durations
-    TrafficLight trafficLights[4];
-    trafficLights[0] = initTrafficLight(SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5, SCREEN_HEIGHT / 4, 15, RED, 5000);    // A2 light
-    trafficLights[1] = initTrafficLight(SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5, SCREEN_HEIGHT * 3 / 4, 15, GREEN, 5000); // B2 light
-    trafficLights[2] = initTrafficLight(SCREEN_WIDTH * 3 / 4, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5, 15, RED, 5000); // C2 light
-    trafficLights[3] = initTrafficLight(SCREEN_WIDTH / 4, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5, 15, GREEN, 5000);  // D2 light
+    // Light timing; one compiled plan could drive any number of intersections
+    static const char* const lightNames[4] = {"A2", "B2", "C2", "D2"};
+    SignalPlan plan;
+    if (signalPlanPath) {
+        if (!loadSignalPlan(&plan, signalPlanPath, lightNames, 4)) {
+            freeSignalPlan(&plan);
+            TTF_CloseFont(font);
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            TTF_Quit();
+            SDL_Quit();
+            return 1;
+        }
+    } else {
+        defaultSignalPlan(&plan);
+    }
 
-    // Initialize vehicle queues for each incoming lane
-    const int MAX_VEHICLES = 10;
-    VehicleQueue incomingVehicleQueues[4];
-    
-    // Different generation intervals for variety (milliseconds)
-    incomingVehicleQueues[0] = initVehicleQueue(MAX_VEHICLES, 3000, 'D', 3);  // D3 to A1 vehicles
-    incomingVehicleQueues[1] = initVehicleQueue(MAX_VEHICLES, 4000, 'B', 3);  // B3 to D1 vehicles
-    incomingVehicleQueues[2] = initVehicleQueue(MAX_VEHICLES, 3500, 'C', 3);  // C3 to B1 vehicles
-    incomingVehicleQueues[3] = initVehicleQueue(MAX_VEHICLES, 4500, 'A', 3);  // A3 to C1 vehicles
+    Simulation sim;
+    if (backlogCapacity < 1) backlogCapacity = 1;
+    initSimulation(&sim, seed, laneCapacity, backlogCapacity, generationIntervals, &plan);
+    if (loadSnapshotPath && !loadSnapshot(&sim, loadSnapshotPath)) {
+        freeSimulation(&sim);
+        freeSignalPlan(&plan);
+        TTF_CloseFont(font);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
 
-    // Initialize vehicle queues for middle lanes
-    VehicleQueue middleLaneQueues[4];
-    middleLaneQueues[0] = initVehicleQueue(MAX_VEHICLES, 2000, 'A', 2);  // A2 to B2 vehicles
-    middleLaneQueues[1] = initVehicleQueue(MAX_VEHICLES, 2500, 'B', 2);  // B2 to A2 vehicles
-    middleLaneQueues[2] = initVehicleQueue(MAX_VEHICLES, 3000, 'C', 2);  // C2 to D2 vehicles
-    middleLaneQueues[3] = initVehicleQueue(MAX_VEHICLES, 3500, 'D', 2);  // D2 to C2 vehicles
+    Ingest ingest;
+    if (ingestDirectory) {
+        if (!startIngest(&ingest, ingestDirectory)) {
+            freeSimulation(&sim);
+            freeSignalPlan(&plan);
+            TTF_CloseFont(font);
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            TTF_Quit();
+            SDL_Quit();
+            return 1;
+        }
+        sim.ingest = &ingest;
+    }
+
+    // Optional services; failing to start one is reported but not fatal
+    Telemetry telemetry;
+    bool publishing = telemetryPath && startTelemetry(&telemetry, telemetryPath, telemetryIntervalMs);
+
+    FrameCapture capture;
+    bool capturing = false;
+    if (captureTarget) {
+        if (captureBuffers < 1) captureBuffers = 1;
+        capturing = startCapture(&capture, SCREEN_WIDTH, SCREEN_HEIGHT, captureBuffers, captureTarget);
+        if (!capturing) {
+            if (sim.ingest) {
+                stopIngest(&ingest);
+            }
+            if (publishing) {
+                stopTelemetry(&telemetry);
+            }
+            freeSimulation(&sim);
+            freeSignalPlan(&plan);
+            TTF_CloseFont(font);
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            TTF_Quit();
+            SDL_Quit();
+            return 1;
+        }
+    }
+
+    RenderView view = {1.0f, lodThreshold, {0}, false, NULL, 0};
+    view.hasDensity = initDensityMap(&view.density, renderer, SCREEN_WIDTH, SCREEN_HEIGHT, DENSITY_CELL_SIZE);
 
     SDL_SetRenderDrawColor(renderer, 0, 150, 0, 255);  // Green background
     SDL_RenderClear(renderer);
 
     drawCrossroad(renderer);
-    drawTrafficLights(renderer, trafficLights, 4);
-
-    SDL_Color laneColor = {255, 255, 255, 255};  // White text color
+    drawTrafficLights(renderer, sim.lights, 4);
 
     int running = 1;
-    Uint32 lastTime = SDL_GetTicks();
+    FrameStats stats = {0};
+    unsigned int frameCount = 0;
+    double accumulator = 0.0;  // Real time not yet consumed by simulation steps
+    Uint64 lastFrameStart = SDL_GetPerformanceCounter();
     
+    TRACE_THREAD_NAME("main");
     while (running) {
+        TRACE_ZONE("frame");
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = 0;
+            } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_s && saveSnapshotPath) {
+                saveSnapshot(&sim, saveSnapshotPath);
+            } else if (event.type == SDL_KEYDOWN) {
+                // +/- zoom around the intersection centre, 0 resets
+                SDL_Keycode key = event.key.keysym.sym;
+                if (key == SDLK_EQUALS || key == SDLK_PLUS || key == SDLK_KP_PLUS) {
+                    view.zoom = SDL_min(view.zoom * 1.25f, MAX_ZOOM);
+                } else if (key == SDLK_MINUS || key == SDLK_KP_MINUS) {
+                    view.zoom = SDL_max(view.zoom / 1.25f, 1.0f);
+                } else if (key == SDLK_0) {
+                    view.zoom = 1.0f;
+                }
+            } else if (event.type == SDL_MOUSEWHEEL) {
+                if (event.wheel.y > 0) {
+                    view.zoom = SDL_min(view.zoom * 1.25f, MAX_ZOOM);
+                } else if (event.wheel.y < 0) {
+                    view.zoom = SDL_max(view.zoom / 1.25f, 1.0f);
+                }
             }
         }
         
-        Uint32 currentTime = SDL_GetTicks();
-        Uint32 deltaTime = currentTime - lastTime;
-        lastTime = currentTime;
-        
-        // Check A2 priority status and update traffic lights accordingly
-        updatePriorityStatus(&middleLaneQueues[0], trafficLights);
-        
-        // Only update non-priority traffic lights
-        for (int i = 0; i < 4; i++) {
-            if (!trafficLights[i].isPriority) {
-                updateTrafficLight(&trafficLights[i]);
-            }
-        }
-        
-        // Generate new vehicles periodically
-        generateVehicles(incomingVehicleQueues, 4);
-        generateMiddleLaneVehicles(middleLaneQueues, 4);
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        double frameMs = (frameStart - lastFrameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+        lastFrameStart = frameStart;
         
-        // Process incoming lane vehicles
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < incomingVehicleQueues[i].capacity; j++) {
-                if (incomingVehicleQueues[i].vehicles[j].active) {
-                    // Update vehicle positions based on queue type
-                    switch (i) {
-                        case 0:  // D3 to A1
-                            moveVehicleD3toA1(&incomingVehicleQueues[i].vehicles[j], &trafficLights[0]);
-                            break;
-  case 1:  // B3 to D1
-                            moveVehicleB3toD1(&incomingVehicleQueues[i].vehicles[j], &trafficLights[3]);
-                            break;
-                        case 2:  // C3 to B1
-                            moveVehicleC3toB1(&incomingVehicleQueues[i].vehicles[j], &trafficLights[1]);
-                            break;
-                        case 3:  // A3 to C1
-                            moveVehicleA3toC1(&incomingVehicleQueues[i].vehicles[j], &trafficLights[2]);
-                            break;
-                    }
-                    
-                    // Check if vehicle reached destination
-                    if (hasReachedDestination(&incomingVehicleQueues[i].vehicles[j])) {
-                        incomingVehicleQueues[i].vehicles[j].active = false;
-                    }
+        int steps = 0;
+        float alpha = 1.0f;
+        if (fastForward) {
+            // Step as fast as possible for most of a frame, then render once.
+            // After every step, skip the quiet stretch up to the next event
+            // or the next vehicle that reaches a light, the box or its exit.
+            do {
+                stepSimulation(&sim);
+                steps++;
+                int maxSkip = INT_MAX;
+                if (durationMs > 0) {
+                    maxSkip = sim.simTime < durationMs ? (durationMs - sim.simTime + SIM_STEP_MS - 1) / SIM_STEP_MS : 0;
                 }
+                skipQuietSteps(&sim, maxSkip);
+            } while (elapsedMs(frameStart) < TARGET_FRAME_MS * 0.75);
+        } else {
+            // Run as many fixed steps as real time has accumulated, then
+            // interpolate vehicles by the leftover fraction of a step
+            accumulator += frameMs < MAX_FRAME_MS ? frameMs : MAX_FRAME_MS;
+            while (accumulator >= SIM_STEP_MS) {
+                stepSimulation(&sim);
+                accumulator -= SIM_STEP_MS;
+                steps++;
             }
+            alpha = (float)(accumulator / SIM_STEP_MS);
         }
+        double stepMs = elapsedMs(frameStart);
         
-        // Process middle lane vehicles
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < middleLaneQueues[i].capacity; j++) {
-                if (middleLaneQueues[i].vehicles[j].active) {
-                    // Update vehicle positions based on lane
-                    switch (i) {
-                        case 0:  // A2 to B2
-                            moveVehicleA2toB2(&middleLaneQueues[i].vehicles[j], &trafficLights[0]);
-                            break;
-                        case 1:  // B2 to A2
-                            moveVehicleB2toA2(&middleLaneQueues[i].vehicles[j], &trafficLights[1]);
-                            break;
-                        case 2:  // C2 to D2
-                            moveVehicleC2toD2(&middleLaneQueues[i].vehicles[j], &trafficLights[2]);
-                            break;
-                        case 3:  // D2 to C2
-                            moveVehicleD2toC2(&middleLaneQueues[i].vehicles[j], &trafficLights[3]);
-                            break;
-                    }
-                    
-                    // Check if vehicle reached destination
-                    if (hasReachedDestination(&middleLaneQueues[i].vehicles[j])) {
-                        middleLaneQueues[i].vehicles[j].active = false;
-                    }
-                }
-            }
+        renderFrame(renderer, font, &sim, &view, alpha);
+        if (capturing) {
+            // Read back the whole frame, not just the zoomed viewport
+            TRACE_ZONE("captureFrame");
+            applyZoom(renderer, 1.0f);
+            captureFrame(&capture, renderer);
         }
-        
-        // Dequeue vehicles from A2 if it has priority and light is green
-        if (trafficLights[0].isPriority && trafficLights[0].state == GREEN) {
-            // Find the frontmost vehicle in A2 queue
-            int frontVehicleIndex = -1;
-            int minY = SCREEN_HEIGHT;
-            
-            for (int j = 0; j < middleLaneQueues[0].capacity; j++) {
-                if (middleLaneQueues[0].vehicles[j].active && 
-                    middleLaneQueues[0].vehicles[j].rect.y < minY &&
-                    middleLaneQueues[0].vehicles[j].rect.y >= SCREEN_HEIGHT / 3) {
-                    minY = middleLaneQueues[0].vehicles[j].rect.y;
-                    frontVehicleIndex = j;
-                }
-            }
-            
-            // Move the frontmost vehicle
-            if (frontVehicleIndex != -1) {
-                middleLaneQueues[0].vehicles[frontVehicleIndex].speed = 6;  // Slightly faster when dequeuing
-            }
+        if (!headless) {
+            TRACE_ZONE("SDL_RenderPresent");
+            SDL_RenderPresent(renderer);
         }
-        
-        // Clear the renderer
-        SDL_SetRenderDrawColor(renderer, 0, 150, 0, 255);  // Green background
-        SDL_RenderClear(renderer);
-        
-        // Draw roads, traffic lights, and lane names
-        drawCrossroad(renderer);
-        drawTrafficLights(renderer, trafficLights, 4);
-        
-        // Draw text for lane names (A1, A2, etc.)
-        SDL_Color laneColor = {255, 255, 255, 255};  // White text color
-        
-        // Draw lane names
-        renderText(renderer, font, "A1", SCREEN_WIDTH / 3 + LANE_WIDTH / 4 - 15, SCREEN_HEIGHT / 6, laneColor);
-        renderText(renderer, font, "A2", SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 15, SCREEN_HEIGHT / 6, laneColor);
-        renderText(renderer, font, "A3", SCREEN_WIDTH / 3 + LANE_WIDTH * 2.5 - 15, SCREEN_HEIGHT / 6, laneColor);
-        
-        renderText(renderer, font, "B1", SCREEN_WIDTH / 3 + LANE_WIDTH / 4 - 15, SCREEN_HEIGHT * 5 / 6, laneColor);
-        renderText(renderer, font, "B2", SCREEN_WIDTH / 3 + LANE_WIDTH * 1.5 - 15, SCREEN_HEIGHT * 5 / 6, laneColor);
-        renderText(renderer, font, "B3", SCREEN_WIDTH / 3 + LANE_WIDTH * 2.5 - 15, SCREEN_HEIGHT * 5 / 6, laneColor);
-        
-        renderText(renderer, font, "C1", SCREEN_WIDTH * 5 / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH / 4 - 15, laneColor);
-        renderText(renderer, font, "C2", SCREEN_WIDTH * 5 / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 15, laneColor);
-        renderText(renderer, font, "C3", SCREEN_WIDTH * 5 / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 2.5 - 15, laneColor);
-        
-        renderText(renderer, font, "D1", SCREEN_WIDTH / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH / 4 - 15, laneColor);
-        renderText(renderer, font, "D2", SCREEN_WIDTH / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 1.5 - 15, laneColor);
-        renderText(renderer, font, "D3", SCREEN_WIDTH / 6, SCREEN_HEIGHT / 3 + LANE_WIDTH * 2.5 - 15, laneColor);
-        
-        // Draw all vehicles from incoming lanes
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < incomingVehicleQueues[i].capacity; j++) {
-                if (incomingVehicleQueues[i].vehicles[j].active) {
-                    drawVehicle(renderer, &incomingVehicleQueues[i].vehicles[j]);
-                }
-            }
+        updateFrameStats(&stats, window, frameMs, stepMs, steps);
+        frameCount++;
+        if (publishing) {
+            TelemetryStats sample;
+            collectTelemetry(&sim, &stats, frameCount, &sample);
+            publishTelemetry(&telemetry, &sample);
         }
         
-        // Draw all vehicles from middle lanes
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < middleLaneQueues[i].capacity; j++) {
-                if (middleLaneQueues[i].vehicles[j].active) {
-                    drawVehicle(renderer, &middleLaneQueues[i].vehicles[j]);
-                }
+        // Without vsync, sleep away whatever is left of the frame budget
+        if (!vsync && !fastForward) {
+            double remaining = TARGET_FRAME_MS - elapsedMs(frameStart);
+            if (remaining >= 1.0) {
+                SDL_Delay((Uint32)remaining);
             }
         }
         
-        // Update queue size counts (for priority logic, but not displayed)
-        int queueSizes[4] = {0, 0, 0, 0};
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < middleLaneQueues[i].capacity; j++) {
-                if (middleLaneQueues[i].vehicles[j].active) {
-                    queueSizes[i]++;
-                }
-            }
-            
-            // Update queue size in the structure
-            middleLaneQueues[i].size = queueSizes[i];
+        if (durationMs > 0 && sim.simTime >= durationMs) {
+            running = 0;
         }
-        
-        SDL_RenderPresent(renderer);
-        
-        // Cap the frame rate to prevent CPU hogging
-        SDL_Delay(16);  // ~60 FPS
     }
     
+    if (saveSnapshotPath) {
+        saveSnapshot(&sim, saveSnapshotPath);
+    }
+    printLaneCounters(&sim);
+    if (publishing) {
+        stopTelemetry(&telemetry);
+    }
+    if (sim.ingest) {
+        stopIngest(&ingest);
+        printf("Ingested %u vehicles (%u for exit lanes ignored, %u malformed lines)\n",
+               atomic_load(&ingest.ingested), sim.ignoredArrivals, atomic_load(&ingest.malformed));
+    }
+    if (capturing) {
+        stopCapture(&capture);
+        printf("Captured %u frames (%u dropped, %u failed)\n",
+               capture.captured, capture.dropped, capture.failed);
+    }
+    TRACE_DUMP("simulator_trace.json");
+    
     // Clean up
-    for (int i = 0; i < 4; i++) {
-        free(incomingVehicleQueues[i].vehicles);
-        free(middleLaneQueues[i].vehicles);
+    freeSimulation(&sim);
+    freeSignalPlan(&plan);
+    if (view.hasDensity) {
+        freeDensityMap(&view.density);
     }
+    free(view.rects);
     
     TTF_CloseFont(font);
+    if (renderTarget) {
+        SDL_DestroyTexture(renderTarget);
+    }
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_Quit();
@@ -773,6 +1749,3 @@ int main(int argc, char *argv[]) {
     
     return 0;
 }
-
-
-
@@ -0,0 +1,180 @@
+#include "telemetry.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS: SIGPIPE is ignored through SO_NOSIGPIPE instead
+#endif
+
+// Copy the newest sample; false until the first one is published. Retries
+// if the simulation rewrote the buffer during the copy.
+static bool readLatest(Telemetry *telemetry, TelemetryStats *stats) {
+    while (1) {
+        int index = atomic_load_explicit(&telemetry->latest, memory_order_acquire);
+        if (index < 0) return false;
+        TelemetryBuffer* buffer = &telemetry->buffers[index];
+
+        unsigned int before = atomic_load_explicit(&buffer->sequence, memory_order_acquire);
+        if (before & 1) continue;
+        memcpy(stats, &buffer->stats, sizeof(*stats));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&buffer->sequence, memory_order_relaxed) == before) return true;
+    }
+}
+
+// Format one sample as a single JSON line
+static int formatStats(const TelemetryStats *stats, char *line, size_t size) {
+    int length = snprintf(line, size,
+                          "{\"time\":%u,\"frame\":%u,\"frameMs\":%.3f,\"stepMs\":%.4f,\"lanes\":[",
+                          stats->simTime, stats->frame, stats->frameMs, stats->stepMs);
+    for (int i = 0; i < TELEMETRY_LANES && length < (int)size; i++) {
+        const LaneTelemetry* lane = &stats->lanes[i];
+        length += snprintf(line + length, size - length,
+                           "%s{\"lane\":\"%c%d\",\"size\":%d,\"backlog\":%d,\"served\":%u,\"dropped\":%u}",
+                           i > 0 ? "," : "", lane->road, lane->lane, lane->size,
+                           lane->backlog, lane->served, lane->dropped);
+    }
+    for (int i = 0; i < TELEMETRY_LIGHTS && length < (int)size; i++) {
+        length += snprintf(line + length, size - length, "%s\"%s\"",
+                           i > 0 ? "," : "],\"lights\":[", stats->lights[i] ? stats->lights[i] : "");
+    }
+    if (length < (int)size) {
+        length += snprintf(line + length, size - length, "]}\n");
+    }
+    return length < (int)size ? length : -1;
+}
+
+static void dropClient(Telemetry *telemetry, int index) {
+    close(telemetry->clients[index]);
+    telemetry->clients[index] = telemetry->clients[--telemetry->clientCount];
+}
+
+static void acceptClients(Telemetry *telemetry) {
+    int client;
+    while ((client = accept(telemetry->listener, NULL, NULL)) >= 0) {
+        if (telemetry->clientCount == MAX_TELEMETRY_CLIENTS) {
+            close(client);
+            continue;
+        }
+        fcntl(client, F_SETFL, O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        telemetry->clients[telemetry->clientCount++] = client;
+    }
+}
+
+// Send a line to every client. Clients too slow to take a whole line are
+// disconnected rather than allowed to hold anything up.
+static void broadcast(Telemetry *telemetry, const char *line, int length) {
+    for (int i = telemetry->clientCount - 1; i >= 0; i--) {
+        if (send(telemetry->clients[i], line, length, MSG_NOSIGNAL | MSG_DONTWAIT) != length) {
+            dropClient(telemetry, i);
+        }
+    }
+}
+
+// Side thread: accept subscribers and send them the latest sample every interval
+static int telemetryThread(void *data) {
+    Telemetry *telemetry = (Telemetry*)data;
+    Uint32 nextSend = SDL_GetTicks();
+
+    while (!atomic_load(&telemetry->stopping)) {
+        int wait = (int)(nextSend - SDL_GetTicks());
+        struct pollfd request = {telemetry->listener, POLLIN, 0};
+        if (wait > 0 && poll(&request, 1, wait) > 0) {
+            acceptClients(telemetry);
+            continue;
+        }
+
+        nextSend += telemetry->intervalMs;
+        if ((int)(SDL_GetTicks() - nextSend) > 0) {
+            nextSend = SDL_GetTicks();  // Fell behind; don't send a burst
+        }
+
+        TelemetryStats stats;
+        char line[2048];
+        if (telemetry->clientCount > 0 && readLatest(telemetry, &stats)) {
+            int length = formatStats(&stats, line, sizeof(line));
+            if (length > 0) broadcast(telemetry, line, length);
+        }
+    }
+    return 0;
+}
+
+// Telemetry operations implementation
+bool startTelemetry(Telemetry *telemetry, const char *path, int intervalMs) {
+    memset(telemetry, 0, sizeof(*telemetry));
+    atomic_init(&telemetry->latest, -1);
+    atomic_init(&telemetry->stopping, false);
+    atomic_init(&telemetry->buffers[0].sequence, 0);
+    atomic_init(&telemetry->buffers[1].sequence, 0);
+    telemetry->intervalMs = intervalMs > 0 ? intervalMs : 1;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Telemetry socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    strcpy(telemetry->path, path);
+
+    telemetry->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (telemetry->listener < 0) {
+        printf("Could not create telemetry socket: %s\n", strerror(errno));
+        return false;
+    }
+    unlink(path);  // Remove a socket left behind by an earlier run
+    if (bind(telemetry->listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(telemetry->listener, MAX_TELEMETRY_CLIENTS) != 0) {
+        printf("Could not listen on %s: %s\n", path, strerror(errno));
+        close(telemetry->listener);
+        return false;
+    }
+    fcntl(telemetry->listener, F_SETFL, O_NONBLOCK);
+
+    telemetry->thread = SDL_CreateThread(telemetryThread, "telemetry", telemetry);
+    if (!telemetry->thread) {
+        printf("Could not start telemetry thread! SDL_Error: %s\n", SDL_GetError());
+        close(telemetry->listener);
+        unlink(path);
+        return false;
+    }
+    return true;
+}
+
+void publishTelemetry(Telemetry *telemetry, const TelemetryStats *stats) {
+    // Write the buffer readers are not pointed at, then point them at it
+    int index = atomic_load_explicit(&telemetry->latest, memory_order_relaxed) == 0 ? 1 : 0;
+    TelemetryBuffer* buffer = &telemetry->buffers[index];
+
+    unsigned int sequence = atomic_load_explicit(&buffer->sequence, memory_order_relaxed);
+    atomic_store_explicit(&buffer->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&buffer->stats, stats, sizeof(*stats));
+    atomic_store_explicit(&buffer->sequence, sequence + 2, memory_order_release);
+    atomic_store_explicit(&telemetry->latest, index, memory_order_release);
+}
+
+void stopTelemetry(Telemetry *telemetry) {
+    if (!telemetry->thread) return;
+    atomic_store(&telemetry->stopping, true);
+    SDL_WaitThread(telemetry->thread, NULL);
+    telemetry->thread = NULL;
+
+    for (int i = 0; i < telemetry->clientCount; i++) {
+        close(telemetry->clients[i]);
+    }
+    telemetry->clientCount = 0;
+    close(telemetry->listener);
+    unlink(telemetry->path);
+}
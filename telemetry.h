@@ -0,0 +1,58 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define TELEMETRY_LANES 8
+#define TELEMETRY_LIGHTS 4
+#define MAX_TELEMETRY_CLIENTS 16
+
+typedef struct {
+    char road;
+    int lane;
+    int size;               // Vehicles in the visible lane
+    int backlog;            // Vehicles waiting to enter it
+    unsigned int served;
+    unsigned int dropped;
+} LaneTelemetry;
+
+// One published sample of the simulation state
+typedef struct {
+    Uint32 simTime;
+    unsigned int frame;
+    double frameMs;
+    double stepMs;
+    LaneTelemetry lanes[TELEMETRY_LANES];
+    const char* lights[TELEMETRY_LIGHTS];   // Static state names, e.g. "red"
+} TelemetryStats;
+
+// Sample slot guarded by a sequence counter that is odd while it is written
+typedef struct {
+    atomic_uint sequence;
+    TelemetryStats stats;
+} TelemetryBuffer;
+
+// Streams stats as line-delimited JSON to every client of a UNIX domain
+// socket. The simulation publishes into alternating buffers without
+// waiting; a side thread copies the latest sample and does all socket work.
+typedef struct {
+    char path[108];
+    int listener;
+    int clients[MAX_TELEMETRY_CLIENTS];
+    int clientCount;
+    int intervalMs;                     // Time between samples sent
+    TelemetryBuffer buffers[2];
+    atomic_int latest;                  // Buffer holding the newest sample, -1 before the first
+    SDL_Thread* thread;
+    atomic_bool stopping;
+} Telemetry;
+
+// Telemetry operations. publishTelemetry is called from the simulation
+// thread only.
+bool startTelemetry(Telemetry *telemetry, const char *path, int intervalMs);
+void publishTelemetry(Telemetry *telemetry, const TelemetryStats *stats);
+void stopTelemetry(Telemetry *telemetry);
+
+#endif /* TELEMETRY_H */
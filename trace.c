@@ -0,0 +1,126 @@
+#include "trace.h"
+
+#ifdef ENABLE_TRACE
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Zones each thread can record before further zones are dropped
+#define TRACE_BUFFER_EVENTS (1 << 18)
+
+typedef struct {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+} TraceEvent;
+
+// One buffer per thread. Only the owning thread writes events; count is
+// published with release ordering so the dump sees complete entries.
+typedef struct TraceBuffer {
+    TraceEvent* events;
+    atomic_int count;
+    atomic_uint dropped;
+    int threadId;
+    const char* threadName;
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+static _Atomic(TraceBuffer*) traceBuffers = NULL;
+static atomic_int nextThreadId = 1;
+static _Thread_local TraceBuffer* threadBuffer = NULL;
+
+static uint64_t traceNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Create this thread's buffer on first use and push it onto the global list
+static TraceBuffer* currentBuffer(void) {
+    if (threadBuffer) return threadBuffer;
+
+    TraceBuffer* buffer = (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!buffer) return NULL;
+    buffer->events = (TraceEvent*)malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+    if (!buffer->events) {
+        free(buffer);
+        return NULL;
+    }
+    buffer->threadId = atomic_fetch_add(&nextThreadId, 1);
+
+    TraceBuffer* head = atomic_load(&traceBuffers);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak(&traceBuffers, &head, buffer));
+
+    threadBuffer = buffer;
+    return buffer;
+}
+
+// Tracing operations implementation
+TraceZone traceBegin(const char *name) {
+    TraceZone zone = {name, traceNow()};
+    return zone;
+}
+
+void traceEnd(TraceZone *zone) {
+    uint64_t end = traceNow();
+    TraceBuffer* buffer = currentBuffer();
+    if (!buffer) return;
+
+    int count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    if (count == TRACE_BUFFER_EVENTS) {
+        atomic_fetch_add_explicit(&buffer->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    buffer->events[count].name = zone->name;
+    buffer->events[count].start = zone->start;
+    buffer->events[count].duration = end - zone->start;
+    atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
+
+void traceThreadName(const char *name) {
+    TraceBuffer* buffer = currentBuffer();
+    if (buffer) buffer->threadName = name;
+}
+
+// Write every recorded zone as a complete ("X") trace event, timestamps in
+// microseconds as the trace-event format expects
+bool traceWrite(const char *path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("Could not write trace to %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    unsigned int dropped = 0;
+    for (TraceBuffer* buffer = atomic_load(&traceBuffers); buffer; buffer = buffer->next) {
+        if (buffer->threadName) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", buffer->threadId, buffer->threadName);
+            first = false;
+        }
+        int count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+        for (int i = 0; i < count; i++) {
+            TraceEvent* event = &buffer->events[i];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event->name, buffer->threadId,
+                    event->start / 1000.0, event->duration / 1000.0);
+            first = false;
+        }
+        dropped += atomic_load_explicit(&buffer->dropped, memory_order_relaxed);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = fclose(file) == 0;
+    printf("Trace written to %s", path);
+    if (dropped > 0) printf(" (%u zones dropped)", dropped);
+    printf("\n");
+    return ok;
+}
+
+#endif /* ENABLE_TRACE */
@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Scoped zone tracing. Build with `make TRACE=1` (defines ENABLE_TRACE) to
+// record every TRACE_ZONE into per-thread buffers and write a Chrome /
+// Perfetto trace-event JSON file with TRACE_DUMP. Without it the macros
+// expand to nothing.
+//
+//     void stepSimulation(...) {
+//         TRACE_ZONE("stepSimulation");  // Ends when the enclosing scope exits
+//         ...
+//     }
+
+#ifdef ENABLE_TRACE
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    const char* name;   // Must be a string literal or otherwise outlive the trace
+    uint64_t start;     // Nanoseconds on the monotonic clock
+} TraceZone;
+
+// Tracing operations
+TraceZone traceBegin(const char *name);
+void traceEnd(TraceZone *zone);
+void traceThreadName(const char *name);
+bool traceWrite(const char *path);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) \
+    TraceZone TRACE_CONCAT(traceZone, __LINE__) __attribute__((cleanup(traceEnd))) = traceBegin(name)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+#define TRACE_DUMP(path) traceWrite(path)
+
+#else
+
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)(name))
+#define TRACE_DUMP(path) ((void)0)
+
+#endif /* ENABLE_TRACE */
+
+#endif /* TRACE_H */
@@ -3,6 +3,12 @@
 #include <time.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "rng.h"
+#include "trace.h"
 
 // Constants for lanes
 #define NUM_ROADS 4
@@ -10,6 +16,19 @@
 #define MAX_VEHICLES_PRIORITY 10
 #define MIN_VEHICLES_PRIORITY 5
 
+// Sharded mode: bytes each producer buffers before writing, and how often
+// buffered vehicles are flushed so readers see them promptly (nanoseconds)
+#define PRODUCER_BUFFER_SIZE (1 << 20)
+#define PRODUCER_FLUSH_NS 50000000LL
+
+// Cleared by Ctrl+C so the generator can shut down cleanly
+static atomic_int running = 1;
+
+static void handleInterrupt(int signal) {
+    (void)signal;
+    atomic_store(&running, 0);
+}
+
 // Structure to represent a vehicle
 typedef struct {
     char number[9];
@@ -18,32 +37,45 @@ typedef struct {
     int priority;
 } Vehicle;
 
+// One producer thread of the sharded mode. It owns its road's lane file,
+// random stream and counters, so producers never share a lock.
+typedef struct {
+    char road;
+    Rng rng;
+    double rate;            // Vehicles per second, 0 for unlimited
+    long long limit;        // Vehicles to produce, 0 for no limit
+    long long produced;
+    int priorityCount;      // Vehicles written to lane 2 of this road
+    pthread_t thread;
+} Producer;
+
 // Function to generate a random vehicle number
-void generateVehicleNumber(char* buffer) {
-    buffer[0] = 'A' + rand() % 26;
-    buffer[1] = 'A' + rand() % 26;
-    buffer[2] = '0' + rand() % 10;
-    buffer[3] = 'A' + rand() % 26;
-    buffer[4] = 'A' + rand() % 26;
-    buffer[5] = '0' + rand() % 10;
-    buffer[6] = '0' + rand() % 10;
-    buffer[7] = '0' + rand() % 10;
+void generateVehicleNumber(char* buffer, Rng* rng) {
+    buffer[0] = 'A' + randomRange(rng, 26);
+    buffer[1] = 'A' + randomRange(rng, 26);
+    buffer[2] = '0' + randomRange(rng, 10);
+    buffer[3] = 'A' + randomRange(rng, 26);
+    buffer[4] = 'A' + randomRange(rng, 26);
+    buffer[5] = '0' + randomRange(rng, 10);
+    buffer[6] = '0' + randomRange(rng, 10);
+    buffer[7] = '0' + randomRange(rng, 10);
     buffer[8] = '\0';
 }
 
 // Function to generate random road
-char generateRoad() {
+char generateRoad(Rng* rng) {
     char roads[] = {'A', 'B', 'C', 'D'};
-    return roads[rand() % NUM_ROADS];
+    return roads[randomRange(rng, NUM_ROADS)];
 }
 
 // Function to generate random lane number (1-3)
-int generateLane() {
-    return (rand() % LANES_PER_ROAD) + 1;
+int generateLane(Rng* rng) {
+    return randomRange(rng, LANES_PER_ROAD) + 1;
 }
 
 // Function to write vehicle data to road-specific file
 void writeVehicleToFile(Vehicle* vehicle) {
+    TRACE_ZONE("writeVehicleToFile");
     char filename[20];
     snprintf(filename, sizeof(filename), "lane%c.txt", vehicle->road);
     
@@ -65,6 +97,7 @@ void writeVehicleToFile(Vehicle* vehicle) {
 
 // Function to count vehicles in a specific lane file
 int countVehiclesInLane(char road, int lane) {
+    TRACE_ZONE("countVehiclesInLane");
     char filename[20];
     snprintf(filename, sizeof(filename), "lane%c.txt", road);
     
@@ -92,8 +125,128 @@ int checkPriorityStatus(char road, int lane) {
     return (vehicleCount >= MAX_VEHICLES_PRIORITY);
 }
 
-int main() {
-    srand(time(NULL));
+// Monotonic clock in nanoseconds
+long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Producer thread: generate vehicles for one road at the producer's rate.
+// Lines collect in the file's large stdio buffer and are flushed in bulk.
+void* runProducer(void* data) {
+    static const char* threadNames[NUM_ROADS] = {"road A", "road B", "road C", "road D"};
+    Producer* producer = (Producer*)data;
+    TRACE_THREAD_NAME(threadNames[producer->road - 'A']);
+    
+    char filename[20];
+    snprintf(filename, sizeof(filename), "lane%c.txt", producer->road);
+    FILE* file = fopen(filename, "a");
+    if (!file) {
+        perror("Error opening file");
+        return NULL;
+    }
+    setvbuf(file, NULL, _IOFBF, PRODUCER_BUFFER_SIZE);
+    
+    long long start = nowNs();
+    long long lastFlush = start;
+    while (atomic_load_explicit(&running, memory_order_relaxed) &&
+           (producer->limit == 0 || producer->produced < producer->limit)) {
+        Vehicle vehicle;
+        generateVehicleNumber(vehicle.number, &producer->rng);
+        vehicle.road = producer->road;
+        vehicle.lane = generateLane(&producer->rng);
+        
+        // Same rule as the default mode, counted in memory instead of
+        // rereading the file
+        vehicle.priority = 0;
+        if (vehicle.road == 'A' && vehicle.lane == 2) {
+            vehicle.priority = ++producer->priorityCount > MAX_VEHICLES_PRIORITY ? 1 : 0;
+        }
+        
+        fprintf(file, "%s:%c%d:%d\n", vehicle.number, vehicle.road, vehicle.lane, vehicle.priority);
+        producer->produced++;
+        
+        long long now = nowNs();
+        if (now - lastFlush >= PRODUCER_FLUSH_NS) {
+            TRACE_ZONE("flushProducer");
+            fflush(file);
+            lastFlush = now;
+        }
+        
+        // Stay on schedule: vehicle n is due n / rate seconds after the start
+        if (producer->rate > 0) {
+            long long due = start + (long long)(producer->produced * 1e9 / producer->rate);
+            if (due > now) {
+                struct timespec wait = {(due - now) / 1000000000LL, (due - now) % 1000000000LL};
+                nanosleep(&wait, NULL);
+            }
+        }
+    }
+    
+    fclose(file);
+    return NULL;
+}
+
+// Sharded mode: one producer thread per road sharing the total rate and limit
+int runProducers(uint64_t seed, double rate, long long limit) {
+    Producer producers[NUM_ROADS];
+    long long startNs = nowNs();
+    
+    for (int i = 0; i < NUM_ROADS; i++) {
+        Producer* producer = &producers[i];
+        producer->road = 'A' + i;
+        seedRng(&producer->rng, seed + i);  // Independent stream per road
+        producer->rate = rate / NUM_ROADS;
+        producer->limit = limit > 0 ? limit / NUM_ROADS + (i < limit % NUM_ROADS) : 0;
+        producer->produced = 0;
+        producer->priorityCount = 0;
+        if (pthread_create(&producer->thread, NULL, runProducer, producer) != 0) {
+            perror("Error starting producer");
+            atomic_store(&running, 0);
+            for (int j = 0; j < i; j++) {
+                pthread_join(producers[j].thread, NULL);
+            }
+            return 1;
+        }
+    }
+    
+    long long total = 0;
+    for (int i = 0; i < NUM_ROADS; i++) {
+        pthread_join(producers[i].thread, NULL);
+        total += producers[i].produced;
+    }
+    double seconds = (nowNs() - startNs) / 1e9;
+    printf("Generated %lld vehicles in %.2f s (%.0f vehicles/s)\n",
+           total, seconds, seconds > 0 ? total / seconds : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // --threads runs one producer per road instead of the default one
+    // vehicle every 1-3 seconds; --rate sets their combined vehicles per
+    // second (0 = as fast as possible), --count stops after that many
+    // vehicles and --seed fixes the random streams.
+    bool sharded = false;
+    double rate = 1000.0;
+    long long limit = 0;
+    uint64_t seed = time(NULL);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0) {
+            sharded = true;
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            limit = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+    }
+    
+    Rng rng;
+    seedRng(&rng, seed);
+    signal(SIGINT, handleInterrupt);
+    TRACE_THREAD_NAME("generator");
     
     // Initialize or clear existing lane files
     char roads[] = {'A', 'B', 'C', 'D'};
@@ -104,11 +257,17 @@ int main() {
         if (file) fclose(file);
     }
     
-    while (1) {
+    if (sharded) {
+        int status = runProducers(seed, rate, limit);
+        TRACE_DUMP("generator_trace.json");
+        return status;
+    }
+    
+    while (atomic_load(&running)) {
         Vehicle vehicle;
-        generateVehicleNumber(vehicle.number);
-        vehicle.road = generateRoad();
-        vehicle.lane = generateLane();
+        generateVehicleNumber(vehicle.number, &rng);
+        vehicle.road = generateRoad(&rng);
+        vehicle.lane = generateLane(&rng);
         
         // Check priority for lane AL2 (A road, lane 2)
         if (vehicle.road == 'A' && vehicle.lane == 2) {
@@ -125,8 +284,9 @@ int main() {
                vehicle.number, vehicle.road, vehicle.lane, vehicle.priority);
         
         // Random delay between 1-3 seconds
-        sleep(1 + (rand() % 3));
+        sleep(1 + randomRange(&rng, 3));
     }
     
+    TRACE_DUMP("generator_trace.json");
     return 0;
 }
\ No newline at end of file